@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "libsysops.h"
+
+
+#define DEFAULT_NO_BLOCKS 1000000
+#define RANDOM_SEED 2022
+#define BLOCK_TEXT "  1  10  80 ../files/small-file-1.txt\n"
+
+
+double get_time();
+void print_result(char* name, int no_ops, double time);
+void shuffle(int* arr, int length);
+
+
+int main(int argc, char** argv) {
+    // Usage: blocks [number of blocks] [heap|arena]
+    int no_blocks = argc > 1 ? (int) strtol(argv[1], NULL, 10) : DEFAULT_NO_BLOCKS;
+    if (no_blocks <= 0) {
+        fprintf(stderr, "Error: Expected a positive number of blocks.\n");
+        return 1;
+    }
+    if (argc > 2 && strcmp(argv[2], "arena") == 0) set_storage_mode(STORAGE_MODE_ARENA);
+    srand(RANDOM_SEED);
+
+    int* indices = (int*) calloc(no_blocks, sizeof(int));
+    if (indices == NULL || !create_pointers_array(no_blocks)) {
+        fprintf(stderr, "Error: Cannot create a pointers array.\n");
+        return 1;
+    }
+    printf("%-20s %-12s %-12s %s\n", "Operation", "Count", "Total [s]", "Per op [ns]");
+
+    // Fill the whole table
+    double start = get_time();
+    for (int i = 0; i < no_blocks; i++) indices[i] = save_string_block(BLOCK_TEXT);
+    print_result("create (sequential)", no_blocks, get_time() - start);
+
+    // Remove all blocks in random order
+    shuffle(indices, no_blocks);
+    start = get_time();
+    for (int i = 0; i < no_blocks; i++) remove_block_at_index(indices[i]);
+    print_result("remove (random)", no_blocks, get_time() - start);
+
+    // Randomly create and remove blocks (indices[0..no_used-1] are used)
+    int no_used = 0;
+    start = get_time();
+    for (int i = 0; i < no_blocks; i++) {
+        bool create = no_used == 0 || (no_used < no_blocks && rand() % 2 == 0);
+        if (create) {
+            indices[no_used++] = save_string_block(BLOCK_TEXT);
+        } else {
+            int j = rand() % no_used;
+            remove_block_at_index(indices[j]);
+            indices[j] = indices[--no_used];
+        }
+    }
+    print_result("create/remove (mix)", no_blocks, get_time() - start);
+
+    // Reclaim space of removed blocks (arena storage only)
+    start = get_time();
+    compact_pointers_array();
+    print_result("compact", 1, get_time() - start);
+
+    free_pointers_array();
+    free(indices);
+
+    return 0;
+}
+
+
+double get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+void print_result(char* name, int no_ops, double time) {
+    printf("%-20s %-12d %-12.4f %.1f\n", name, no_ops, time, time * 1e9 / no_ops);
+}
+
+void shuffle(int* arr, int length) {
+    for (int i = length - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int temp = arr[i];
+        arr[i] = arr[j];
+        arr[j] = temp;
+    }
+}
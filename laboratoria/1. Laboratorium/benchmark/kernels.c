@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "libsysops.h"
+
+
+#define DEFAULT_FILES_DIR "../files"
+#define TEMP_DIR_TEMPLATE "/tmp/sysops-kernelsXXXXXX"
+#define RANDOM_SEED 2022
+#define MAX_PATH_LENGTH 512
+#define NO_KERNELS 3
+
+
+typedef struct {
+    StatsKernel kernel;
+    char* name;
+    bool is_supported;
+} Kernel;
+
+Kernel kernels[NO_KERNELS] = {
+    {STATS_KERNEL_SCALAR, "scalar", false},
+    {STATS_KERNEL_SSE2, "sse2", false},
+    {STATS_KERNEL_AVX2, "avx2", false}
+};
+
+
+int check_dir(char* dir_path, bool is_verbose);
+bool check_file(char* path, bool is_verbose);
+bool count_with_wc(char* path, FileStats *fs);
+bool generate_inputs(char* dir_path);
+bool write_input(char* dir_path, char* name, char* data, long length);
+void fill_random(char* data, long length);
+void fill_text(char* data, long length);
+void remove_dir(char* dir_path);
+
+
+int main(int argc, char** argv) {
+    // Usage: kernels [files directory]
+    // Every kernel supported by the CPU counts every file of the directory
+    // and generated inputs, and its results are compared with the scalar
+    // kernel and with wc in the C locale
+    char* files_dir = argc > 1 ? argv[1] : DEFAULT_FILES_DIR;
+    srand(RANDOM_SEED);
+
+    for (int i = 0; i < NO_KERNELS; i++) {
+        kernels[i].is_supported = set_stats_kernel(kernels[i].kernel);
+        if (!kernels[i].is_supported) printf("Skipping the %s kernel (not supported by the CPU).\n", kernels[i].name);
+    }
+    printf("%-40s %-10s %-10s %-10s %s\n", "File", "Lines", "Words", "Bytes", "Result");
+
+    char temp_dir[] = TEMP_DIR_TEMPLATE;
+    if (mkdtemp(temp_dir) == NULL) {
+        perror("Error: Cannot create a directory for generated inputs.\n");
+        return 1;
+    }
+    bool is_generated = generate_inputs(temp_dir);
+
+    // Only mismatches of generated inputs are printed (there are many of them)
+    int no_files_mismatches = check_dir(files_dir, true);
+    int no_generated_mismatches = is_generated ? check_dir(temp_dir, false) : -1;
+    remove_dir(temp_dir);
+
+    if (no_files_mismatches < 0 || no_generated_mismatches < 0) return 1;
+    int no_mismatches = no_files_mismatches + no_generated_mismatches;
+    if (no_mismatches > 0) {
+        fprintf(stderr, "Error: %d file(s) counted differently.\n", no_mismatches);
+        return 2;
+    }
+    printf("Success: All kernels agree with wc.\n");
+    return 0;
+}
+
+
+int check_dir(char* dir_path, bool is_verbose) {
+    DIR* dir = opendir(dir_path);
+    if (dir == NULL) {
+        fprintf(stderr, "Error: Cannot open the directory '%s'.\n", dir_path);
+        return -1;
+    }
+
+    int no_files = 0;
+    int no_mismatches = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[MAX_PATH_LENGTH];
+        struct stat sb;
+        snprintf(path, MAX_PATH_LENGTH, "%s/%s", dir_path, entry->d_name);
+        if (stat(path, &sb) < 0 || !S_ISREG(sb.st_mode)) continue;
+        if (!check_file(path, is_verbose)) no_mismatches++;
+        no_files++;
+    }
+
+    closedir(dir);
+    printf("Checked %d files in '%s' (%d mismatches).\n", no_files, dir_path, no_mismatches);
+    return no_mismatches;
+}
+
+bool check_file(char* path, bool is_verbose) {
+    FileStats expected;
+    if (!count_with_wc(path, &expected)) return false;
+
+    bool is_matching = true;
+    char* name = strrchr(path, '/') + 1;
+    for (int i = 0; i < NO_KERNELS; i++) {
+        if (!kernels[i].is_supported) continue;
+        FileStats fs;
+        set_stats_kernel(kernels[i].kernel);
+        if (!count_file_stats(path, &fs)) return false;
+        if (fs.no_lines != expected.no_lines || fs.no_words != expected.no_words || fs.no_bytes != expected.no_bytes) {
+            if (is_matching) {
+                printf("%-40s %-10ld %-10ld %-10ld MISMATCH\n", name, expected.no_lines, expected.no_words,
+                       expected.no_bytes);
+            }
+            printf("    %-36s %-10ld %-10ld %-10ld\n", kernels[i].name, fs.no_lines, fs.no_words, fs.no_bytes);
+            is_matching = false;
+        }
+    }
+    if (is_matching && is_verbose) {
+        printf("%-40s %-10ld %-10ld %-10ld OK\n", name, expected.no_lines, expected.no_words, expected.no_bytes);
+    }
+    return is_matching;
+}
+
+bool count_with_wc(char* path, FileStats *fs) {
+    // Words are counted by the library in the same way as wc in the C locale
+    char cmd[MAX_PATH_LENGTH + 64];
+    snprintf(cmd, sizeof(cmd), "LC_ALL=C wc -l -w -c < '%s'", path);
+    FILE* f_ptr = popen(cmd, "r");
+    if (f_ptr == NULL) {
+        fprintf(stderr, "Error: Cannot run wc for the file '%s'.\n", path);
+        return false;
+    }
+    int no_values = fscanf(f_ptr, "%ld %ld %ld", &fs->no_lines, &fs->no_words, &fs->no_bytes);
+    if (pclose(f_ptr) != 0 || no_values != 3) {
+        fprintf(stderr, "Error: Cannot read the output of wc for the file '%s'.\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool generate_inputs(char* dir_path) {
+    // Lengths around 64-byte blocks and around the read buffer size
+    long lengths[] = {0, 1, 2, 63, 64, 65, 127, 128, 129, 191, 192, 193, 4095, 4096, 4097,
+                      STATS_BUFFER_SIZE - 1, STATS_BUFFER_SIZE, STATS_BUFFER_SIZE + 1, 3 * STATS_BUFFER_SIZE + 17};
+    int no_lengths = sizeof(lengths) / sizeof(lengths[0]);
+    long max_length = lengths[no_lengths - 1];
+    char* data = (char*) malloc(max_length);
+    if (data == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return false;
+    }
+
+    char name[64];
+    bool is_successful = true;
+    for (int i = 0; is_successful && i < no_lengths; i++) {
+        // Any bytes (mostly control and non-ASCII blocks, which are counted
+        // by the scalar fallback of SIMD kernels)
+        fill_random(data, lengths[i]);
+        snprintf(name, sizeof(name), "random-%ld", lengths[i]);
+        is_successful = write_input(dir_path, name, data, lengths[i]);
+        // Text with rare control and non-ASCII bytes (mostly SIMD blocks)
+        fill_text(data, lengths[i]);
+        snprintf(name, sizeof(name), "text-%ld", lengths[i]);
+        is_successful = is_successful && write_input(dir_path, name, data, lengths[i]);
+    }
+
+    // A single separator (whitespace or control byte) at every position of
+    // the first three 64-byte blocks, so words start and end exactly at
+    // block boundaries
+    char separators[] = {' ', '\n', '\t', '\v', '\x01', '\x7f', '\x80', '\xff'};
+    int no_separators = sizeof(separators);
+    for (int i = 0; is_successful && i < no_separators; i++) {
+        for (int j = 0; is_successful && j < 3 * 64; j++) {
+            memset(data, 'a', 3 * 64);
+            data[j] = separators[i];
+            snprintf(name, sizeof(name), "boundary-%02x-%03d", (unsigned char) separators[i], j);
+            is_successful = write_input(dir_path, name, data, 3 * 64);
+        }
+    }
+
+    free(data);
+    return is_successful;
+}
+
+bool write_input(char* dir_path, char* name, char* data, long length) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, MAX_PATH_LENGTH, "%s/%s", dir_path, name);
+    FILE* f_ptr = fopen(path, "w");
+    if (f_ptr == NULL) {
+        fprintf(stderr, "Error: Cannot create the file '%s'.\n", path);
+        return false;
+    }
+    bool is_successful = (long) fwrite(data, sizeof(char), length, f_ptr) == length;
+    if (fclose(f_ptr) != 0 || !is_successful) {
+        fprintf(stderr, "Error: Cannot write the file '%s'.\n", path);
+        return false;
+    }
+    return true;
+}
+
+void fill_random(char* data, long length) {
+    for (long i = 0; i < length; i++) data[i] = (char) (rand() % 256);
+}
+
+void fill_text(char* data, long length) {
+    char* whitespace = " \t\n\v\f\r";
+    for (long i = 0; i < length; i++) {
+        int r = rand() % 1000;
+        if (r < 2) data[i] = (char) (rand() % ' ');                // Control byte
+        else if (r < 4) data[i] = (char) (0x7f + rand() % 0x81);   // DEL or non-ASCII byte
+        else if (r < 200) data[i] = whitespace[rand() % 6];
+        else data[i] = (char) ('!' + rand() % ('~' - '!' + 1));
+    }
+}
+
+void remove_dir(char* dir_path) {
+    DIR* dir = opendir(dir_path);
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char path[MAX_PATH_LENGTH];
+            snprintf(path, MAX_PATH_LENGTH, "%s/%s", dir_path, entry->d_name);
+            unlink(path);
+        }
+        closedir(dir);
+    }
+    rmdir(dir_path);
+}
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+
+#define DEFAULT_NO_RUNS 20
+#define DEFAULT_NO_WARMUPS 2
+#define DEFAULT_TOLERANCE 25.0
+#define NOISE_STDDEVS 3.0
+#define DEFAULT_OUTPUT_PREFIX "results"
+#define MAX_SCENARIOS 64
+#define MAX_PROGRAMS 64
+#define MAX_LINE_LENGTH 512
+#define CSV_HEADER "program,scenario,runs,failures,mean_ms,stddev_ms,min_ms,user_ms,sys_ms\n"
+
+
+typedef struct {
+    char* label;
+    char* path;
+} Program;
+
+typedef struct {
+    char program[128];
+    char scenario[128];
+    int no_runs;
+    int no_failures;
+    double mean;    // Wall-clock times in milliseconds
+    double stddev;
+    double min;
+    double user;    // Mean CPU times in milliseconds
+    double sys;
+    bool is_regression;
+} Result;
+
+typedef struct {
+    int no_runs;
+    int no_warmups;
+    double tolerance;  // Allowed slowdown of the minimum time in percents
+    char* output_prefix;
+    char* baseline_path;
+} Options;
+
+
+bool parse_options(int argc, char** argv, Options *options, char** scenarios, int *no_scenarios);
+bool parse_program(char* arg, Program *program);
+void run_scenario(Program *program, char* scenario, Options *options, Result *result);
+bool run_once(char* path, char* scenario, double *wall, double *user, double *sys);
+double get_time();
+char* get_scenario_name(char* path, char* name, int size);
+int check_baseline(char* path, Result *results, int no_results, double tolerance);
+void print_results(Result *results, int no_results);
+bool write_csv(char* path, Result *results, int no_results);
+bool write_json(char* path, Result *results, int no_results);
+
+
+int main(int argc, char** argv) {
+    // Usage: matrix [-n runs] [-w warmups] [-o output prefix] [-b baseline.csv]
+    //               [-t tolerance %] -s scenario... label=program...
+    Options options = {
+        .no_runs = DEFAULT_NO_RUNS,
+        .no_warmups = DEFAULT_NO_WARMUPS,
+        .tolerance = DEFAULT_TOLERANCE,
+        .output_prefix = DEFAULT_OUTPUT_PREFIX
+    };
+    char* scenarios[MAX_SCENARIOS];
+    int no_scenarios = 0;
+    if (!parse_options(argc, argv, &options, scenarios, &no_scenarios)) return 1;
+
+    Program programs[MAX_PROGRAMS];
+    int no_programs = argc - optind;
+    if (no_programs <= 0 || no_programs > MAX_PROGRAMS) {
+        fprintf(stderr, "Error: Expected from 1 to %d programs (label=path).\n", MAX_PROGRAMS);
+        return 1;
+    }
+    for (int i = 0; i < no_programs; i++) {
+        if (!parse_program(argv[optind + i], &programs[i])) return 1;
+    }
+
+    // Run every scenario with every program
+    int no_results = no_programs * no_scenarios;
+    Result* results = (Result*) calloc(no_results, sizeof(Result));
+    if (results == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return 1;
+    }
+    for (int i = 0; i < no_programs; i++) {
+        for (int j = 0; j < no_scenarios; j++) {
+            run_scenario(&programs[i], scenarios[j], &options, &results[i * no_scenarios + j]);
+        }
+    }
+
+    int no_failures = 0;
+    for (int i = 0; i < no_results; i++) no_failures += results[i].no_failures;
+
+    int no_regressions = 0;
+    if (options.baseline_path != NULL) {
+        no_regressions = check_baseline(options.baseline_path, results, no_results, options.tolerance);
+    }
+    print_results(results, no_results);
+
+    // Save results as CSV (which can be used as a baseline) and JSON
+    char path[MAX_LINE_LENGTH];
+    snprintf(path, MAX_LINE_LENGTH, "%s.csv", options.output_prefix);
+    bool is_successful = write_csv(path, results, no_results);
+    snprintf(path, MAX_LINE_LENGTH, "%s.json", options.output_prefix);
+    is_successful = write_json(path, results, no_results) && is_successful;
+    free(results);
+
+    if (!is_successful || no_regressions < 0) return 1;
+    if (no_failures > 0) {
+        fprintf(stderr, "Error: %d run(s) failed.\n", no_failures);
+        return 1;
+    }
+    if (no_regressions > 0) {
+        fprintf(stderr, "Error: %d regression(s) against the baseline '%s'.\n", no_regressions, options.baseline_path);
+        return 2;
+    }
+    return 0;
+}
+
+
+bool parse_options(int argc, char** argv, Options *options, char** scenarios, int *no_scenarios) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:o:b:t:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                options->no_runs = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'w':
+                options->no_warmups = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'o':
+                options->output_prefix = optarg;
+                break;
+            case 'b':
+                options->baseline_path = optarg;
+                break;
+            case 't':
+                options->tolerance = strtod(optarg, NULL);
+                break;
+            case 's':
+                if (*no_scenarios == MAX_SCENARIOS) {
+                    fprintf(stderr, "Error: Too many scenarios (at most %d).\n", MAX_SCENARIOS);
+                    return false;
+                }
+                scenarios[(*no_scenarios)++] = optarg;
+                break;
+            default:
+                return false;
+        }
+    }
+    if (options->no_runs <= 0 || options->no_warmups < 0 || *no_scenarios == 0) {
+        fprintf(stderr, "Error: Expected a positive number of runs and at least 1 scenario.\n");
+        return false;
+    }
+    return true;
+}
+
+bool parse_program(char* arg, Program *program) {
+    char* separator = strchr(arg, '=');
+    if (separator == NULL || separator == arg || separator[1] == '\0') {
+        fprintf(stderr, "Error: Expected a program as label=path, got '%s'.\n", arg);
+        return false;
+    }
+    *separator = '\0';
+    program->label = arg;
+    program->path = separator + 1;
+    return true;
+}
+
+void run_scenario(Program *program, char* scenario, Options *options, Result *result) {
+    snprintf(result->program, sizeof(result->program), "%s", program->label);
+    get_scenario_name(scenario, result->scenario, sizeof(result->scenario));
+    result->no_runs = options->no_runs;
+
+    // Warm up the page cache and the dynamic loader before measuring
+    double wall, user, sys;
+    for (int i = 0; i < options->no_warmups; i++) run_once(program->path, scenario, &wall, &user, &sys);
+
+    // Welford's algorithm keeps the mean and the variance numerically stable
+    // (failed runs are counted, but their times are left out)
+    int no_successes = 0;
+    double m2 = 0;
+    result->min = INFINITY;
+    for (int i = 0; i < options->no_runs; i++) {
+        if (!run_once(program->path, scenario, &wall, &user, &sys)) {
+            result->no_failures++;
+            continue;
+        }
+        no_successes++;
+        double delta = wall - result->mean;
+        result->mean += delta / no_successes;
+        m2 += delta * (wall - result->mean);
+        if (wall < result->min) result->min = wall;
+        result->user += (user - result->user) / no_successes;
+        result->sys += (sys - result->sys) / no_successes;
+    }
+    if (no_successes == 0) result->min = 0;
+    result->stddev = no_successes > 1 ? sqrt(m2 / (no_successes - 1)) : 0;
+}
+
+bool run_once(char* path, char* scenario, double *wall, double *user, double *sys) {
+    double start = get_time();
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Error: Cannot create a process.\n");
+        exit(1);
+    }
+    if (pid == 0) {
+        // Discard the output of the measured program
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        execl(path, path, "run_script", scenario, NULL);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    *wall = (get_time() - start) * 1e3;
+    *user = (double) usage.ru_utime.tv_sec * 1e3 + (double) usage.ru_utime.tv_usec / 1e3;
+    *sys = (double) usage.ru_stime.tv_sec * 1e3 + (double) usage.ru_stime.tv_usec / 1e3;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+double get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+char* get_scenario_name(char* path, char* name, int size) {
+    // Use the file name without its extension
+    char* base = strrchr(path, '/');
+    snprintf(name, size, "%s", base != NULL ? base + 1 : path);
+    char* extension = strrchr(name, '.');
+    if (extension != NULL && extension != name) *extension = '\0';
+    return name;
+}
+
+int check_baseline(char* path, Result *results, int no_results, double tolerance) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open the baseline '%s'.\n", path);
+        return -1;
+    }
+
+    // A result is a regression if its minimum time (the least noisy one) is
+    // above the minimum time in the baseline by more than tolerance percents
+    // and more than NOISE_STDDEVS standard deviations of either run (runs
+    // of a few milliseconds vary much more than by the tolerance)
+    char line[MAX_LINE_LENGTH];
+    int no_regressions = 0;
+    while (fgets(line, MAX_LINE_LENGTH, file) != NULL) {
+        Result base;
+        if (sscanf(line, "%127[^,],%127[^,],%d,%d,%lf,%lf,%lf", base.program, base.scenario,
+                   &base.no_runs, &base.no_failures, &base.mean, &base.stddev, &base.min) != 7) {
+            continue;
+        }
+        for (int i = 0; i < no_results; i++) {
+            Result *result = &results[i];
+            if (strcmp(result->program, base.program) != 0 || strcmp(result->scenario, base.scenario) != 0) continue;
+            // Results without a successful run have no time to compare
+            if (result->no_failures == result->no_runs || base.no_failures == base.no_runs) continue;
+            double noise = NOISE_STDDEVS * (result->stddev > base.stddev ? result->stddev : base.stddev);
+            double margin = base.min * tolerance / 100;
+            if (noise > margin) margin = noise;
+            if (result->min > base.min + margin) {
+                result->is_regression = true;
+                no_regressions++;
+            }
+        }
+    }
+
+    fclose(file);
+    return no_regressions;
+}
+
+void print_results(Result *results, int no_results) {
+    printf("%-18s %-12s %-6s %-9s %-10s %-10s %-10s %-10s %-10s\n",
+           "Program", "Scenario", "Runs", "Failures", "Mean [ms]", "Stddev", "Min", "User", "System");
+    for (int i = 0; i < no_results; i++) {
+        Result *r = &results[i];
+        printf("%-18s %-12s %-6d %-9d %-10.3f %-10.3f %-10.3f %-10.3f %-10.3f%s\n",
+               r->program, r->scenario, r->no_runs, r->no_failures, r->mean, r->stddev, r->min, r->user, r->sys,
+               r->is_regression ? " REGRESSION" : "");
+    }
+}
+
+bool write_csv(char* path, Result *results, int no_results) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open the file '%s'.\n", path);
+        return false;
+    }
+    fprintf(file, CSV_HEADER);
+    for (int i = 0; i < no_results; i++) {
+        Result *r = &results[i];
+        fprintf(file, "%s,%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                r->program, r->scenario, r->no_runs, r->no_failures, r->mean, r->stddev, r->min, r->user, r->sys);
+    }
+    fclose(file);
+    return true;
+}
+
+bool write_json(char* path, Result *results, int no_results) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open the file '%s'.\n", path);
+        return false;
+    }
+    fprintf(file, "[\n");
+    for (int i = 0; i < no_results; i++) {
+        Result *r = &results[i];
+        fprintf(file, "  {\"program\": \"%s\", \"scenario\": \"%s\", \"runs\": %d, \"failures\": %d, "
+                      "\"mean_ms\": %.3f, \"stddev_ms\": %.3f, \"min_ms\": %.3f, \"user_ms\": %.3f, "
+                      "\"sys_ms\": %.3f, \"regression\": %s}%s\n",
+                r->program, r->scenario, r->no_runs, r->no_failures, r->mean, r->stddev, r->min, r->user, r->sys,
+                r->is_regression ? "true" : "false", i + 1 < no_results ? "," : "");
+    }
+    fprintf(file, "]\n");
+    fclose(file);
+    return true;
+}
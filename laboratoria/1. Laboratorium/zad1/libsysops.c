@@ -2,115 +2,668 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "libsysops.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define SIMD_STATS_KERNELS
+#endif
 
-PointersArray *pa;
+
+/*
+ * Arena records
+ *
+ * In STORAGE_MODE_ARENA each block is stored as a record: a header followed
+ * by the block characters and '\0', padded to ARENA_ALIGNMENT bytes. Removing
+ * a block only marks its record as a tombstone, which is reclaimed by
+ * pa_compact().
+ */
+#define ARENA_ALIGNMENT 8
+
+typedef struct {
+    int length;  // Length of the block without '\0'
+    int idx;     // Index of the block or -1 if the block was removed
+} ArenaRecord;
+
+PointersArray *default_pa;
+StorageMode storage_mode = STORAGE_MODE_HEAP;
+StatsMode stats_mode = STATS_MODE_NATIVE;
+StatsKernel stats_kernel = STATS_KERNEL_AUTO;
+
+// Kernel counting lines and words in a buffer (selected by set_stats_kernel)
+static void (*count_buffer_stats)(char* buffer, long length, FileStats *fs, bool *in_word);
+
+/*
+ * Parallel statistics
+ *
+ * Files are split into ranges of at most STATS_RANGE_SIZE bytes, which are
+ * counted by a fixed pool of worker threads. Each range is counted as if it
+ * started outside of a word, so when ranges are merged, a word which crosses
+ * a range boundary is counted once again and has to be subtracted.
+ */
+typedef enum {
+    BYTE_CLASS_NONE,   // The range has no whitespace or printable bytes
+    BYTE_CLASS_SPACE,
+    BYTE_CLASS_PRINT
+} ByteClass;
+
+typedef struct {
+    int file_idx;
+    long offset;
+    long length;                // -1 if the file has to be read till EOF
+    FileStats fs;
+    ByteClass first_class;      // Class of the first non-control byte
+    bool ends_in_word;
+    bool is_successful;
+} StatsRange;
+
+typedef struct {
+    pthread_mutex_t job_mutex;  // Held by the caller for the whole job (one job at a time)
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;    // Signalled when a new job is posted
+    pthread_cond_t done_cond;   // Signalled when the last worker finishes a job
+    pthread_t *threads;
+    int no_threads;
+    int no_active;              // Workers which haven't finished the current job
+    int generation;             // Incremented with every posted job
+    bool stop;
+    // Current job
+    char** paths;
+    StatsRange *ranges;
+    int no_ranges;
+    int next_range;
+} StatsPool;
+
+StatsPool stats_pool = {
+    .job_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .job_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER
+};
+
+/*
+ * Statistics cache
+ *
+ * Entries are found by the file path and are valid only as long as the
+ * device, inode, size and modification time of the file don't change. The
+ * least recently used entries are evicted when the cache exceeds its limit.
+ */
+typedef struct StatsCacheEntry {
+    struct StatsCacheEntry *next;       // Next entry in the same bucket
+    struct StatsCacheEntry *lru_prev;   // More recently used entry
+    struct StatsCacheEntry *lru_next;   // Less recently used entry
+    uint64_t hash;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    FileStats fs;
+    char path[];
+} StatsCacheEntry;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    StatsCacheEntry *buckets[STATS_CACHE_BUCKETS];
+    StatsCacheEntry *lru_first;
+    StatsCacheEntry *lru_last;
+    long no_hits;
+    long no_misses;
+    long no_entries;
+    long size;
+    long limit;
+} StatsCache;
+
+StatsCache stats_cache = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .limit = STATS_CACHE_DEFAULT_LIMIT
+};
 
 // Library private functions
 int calc_cmd_length(char* temp_path, char** paths, int no_paths);
 char* create_cmd(char* temp_path, char** paths, int no_paths);
+static bool does_pa_exist(PointersArray *pa);
+static void lock_pa(PointersArray *pa);
+static void unlock_pa(PointersArray *pa);
+static char* find_slot_block(PointersArray *pa, int idx);
+static void free_pa_arrays(PointersArray *pa);
+static int find_empty_slot(PointersArray *pa);
+static int save_block(PointersArray *pa, char* block, long length, StatsRecords *records, bool is_owned);
+static bool create_block(PointersArray *pa, char* block, long length, StatsRecords *records, int idx,
+                         bool is_owned);
+static void add_records_total(PointersArray *pa, StatsRecords *records, int sign);
+static bool remove_block(PointersArray *pa, int idx);
+static void mark_slot_used(PointersArray *pa, int idx);
+static void mark_slot_empty(PointersArray *pa, int idx);
+static bool is_slot_used(PointersArray *pa, int idx);
+static void compact_arena(PointersArray *pa);
+static long calc_record_size(int length);
+static bool reserve_arena_space(PointersArray *pa, long size);
+static bool append_arena_record(PointersArray *pa, char* block, int length, int idx);
+static char* get_files_stats_shell(char** paths, int no_paths, long *length);
+static bool check_paths(char** paths, int no_paths);
+static char* get_files_stats_native(char** paths, int no_paths, long *length);
+static FileStats* count_files_stats(char** paths, int no_paths);
+static bool count_fd_stats(int fd, long offset, long length, char* buffer, FileStats *fs, bool *in_word,
+                           ByteClass *first_class);
+static bool count_files_stats_parallel(char** paths, int no_paths, FileStats *stats);
+static StatsRange* create_stats_ranges(char** paths, int no_paths, int *no_ranges);
+static void count_range_stats(char** paths, StatsRange *range, char* buffer);
+static void* stats_worker(void* arg);
+static bool start_stats_pool(int no_threads);
+static void stop_stats_pool();
+static void count_buffer_stats_scalar(char* buffer, long length, FileStats *fs, bool *in_word);
+#ifdef SIMD_STATS_KERNELS
+static void count_buffer_stats_sse2(char* buffer, long length, FileStats *fs, bool *in_word);
+static void count_buffer_stats_avx2(char* buffer, long length, FileStats *fs, bool *in_word);
+#endif
+static bool find_cached_stats(char* path, struct stat *sb, FileStats *fs);
+static void cache_stats(char* path, struct stat *sb, FileStats *fs);
+static void remove_cache_entry(StatsCacheEntry *entry);
+static StatsCacheEntry* find_cache_entry(char* path, uint64_t hash);
+static void link_lru_entry(StatsCacheEntry *entry);
+static void unlink_lru_entry(StatsCacheEntry *entry);
+static void evict_cache_entries(long limit);
+static uint64_t hash_path(char* path);
+static int calc_stats_width(char** paths, int no_paths);
+static int print_stats_line(char* buffer, int size, FileStats *fs, int width, char* name);
+static char* create_stats_block(FileStats *stats, char** paths, int no_paths, long *length);
+static StatsRecords* create_stats_records(FileStats *stats, char** paths, int no_paths);
 
 /*
  * PointersArray
  */
-bool create_pointers_array(int length) {
-    if (pa != NULL) {
-        fprintf(stderr, "Error: Pointers array already exist. Remove the existing pointers array first.\n");
-        return false;
-    }
+void set_storage_mode(StorageMode mode) {
+    storage_mode = mode;
+}
+
+PointersArray* pa_create(int length, StorageMode mode, bool is_shared) {
     if (length <= 0) {
         fprintf(stderr, "Error: Cannot create a pointers array of length %d.\n", length);
-        return false;
+        return NULL;
+    }
+    // Create an array of pointers to the results blocks (or an array of
+    // records offsets if blocks are stored in the arena)
+    PointersArray *pa = (PointersArray*) calloc(1, sizeof(PointersArray));
+    if (pa == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return NULL;
     }
-    // Create an array of pointers to the results blocks
-    pa = (PointersArray*) malloc(sizeof(PointersArray));
-    char** array = (char**) calloc(length, sizeof(char*));
     pa->length = length;
-    pa->array = array;
-    return true;
+    pa->storage_mode = mode;
+    pa->records = (StatsRecords**) calloc(length, sizeof(StatsRecords*));
+    if (mode == STORAGE_MODE_ARENA) {
+        pa->offsets = (long*) calloc(length, sizeof(long));
+        pa->arena = (char*) malloc(ARENA_INITIAL_SIZE);
+        pa->arena_capacity = ARENA_INITIAL_SIZE;
+    } else {
+        pa->array = (char**) calloc(length, sizeof(char*));
+    }
+
+    // Create bitmaps of used slots
+    pa->no_words = (length + 63) / 64;
+    int no_summary_words = (pa->no_words + 63) / 64;
+    pa->used_slots = (uint64_t*) calloc(pa->no_words, sizeof(uint64_t));
+    pa->full_words = (uint64_t*) calloc(no_summary_words, sizeof(uint64_t));
+
+    bool is_allocated = pa->records != NULL && pa->used_slots != NULL && pa->full_words != NULL;
+    if (mode == STORAGE_MODE_ARENA) is_allocated = is_allocated && pa->offsets != NULL && pa->arena != NULL;
+    else is_allocated = is_allocated && pa->array != NULL;
+    if (!is_allocated) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        free_pa_arrays(pa);
+        free(pa);
+        return NULL;
+    }
+    // Bits past the end of the array are marked as used, so they are never
+    // returned as empty slots
+    if (length % 64 != 0) pa->used_slots[pa->no_words - 1] = UINT64_MAX << (length % 64);
+    if (pa->no_words % 64 != 0) pa->full_words[no_summary_words - 1] = UINT64_MAX << (pa->no_words % 64);
+
+    // Tables shared by many threads serialize operations with a mutex
+    pa->is_shared = is_shared;
+    if (is_shared && pthread_mutex_init(&pa->mutex, NULL) != 0) {
+        fprintf(stderr, "Error: Cannot create a mutex of the pointers array.\n");
+        free_pa_arrays(pa);
+        free(pa);
+        return NULL;
+    }
+
+    return pa;
 }
 
-bool free_pointers_array() {
+bool pa_free(PointersArray *pa) {
     if (pa == NULL) {
         fprintf(stderr, "Error: Cannot free a pointers array. Pointers array does not exist.\n");
         return false;
     }
     // Free the remaining elements
-    for (int i = 0; i < pa->length; i++) {
+    for (int i = 0; pa->array != NULL && i < pa->length; i++) {
         if (pa->array[i] != NULL) free(pa->array[i]);
     }
-    // Free the array pointer
-    free(pa->array);
+    for (int i = 0; i < pa->length; i++) free(pa->records[i]);
+    free_pa_arrays(pa);
+    if (pa->is_shared) pthread_mutex_destroy(&pa->mutex);
     // Free PointersArray struct
     free(pa);
 
     return true;
 }
 
-int find_empty_index() {
-    if (pa == NULL) {
-        fprintf(stderr, "Error: Cannot free a pointers array. Pointers array does not exist.\n");
+int pa_find_empty_index(PointersArray *pa) {
+    if (!does_pa_exist(pa)) return -1;
+    lock_pa(pa);
+    int idx = find_empty_slot(pa);
+    unlock_pa(pa);
+    return idx;
+}
+
+bool pa_create_block_at_index(PointersArray *pa, char* block, int idx) {
+    if (!does_pa_exist(pa)) return false;
+    lock_pa(pa);
+    bool is_successful = block != NULL && create_block(pa, block, (long) strlen(block), NULL, idx, false);
+    unlock_pa(pa);
+    if (block == NULL) fprintf(stderr, "Error: Cannot create a memory block. Wrong input parameters.\n");
+    return is_successful;
+}
+
+bool pa_remove(PointersArray *pa, int idx) {
+    if (!does_pa_exist(pa)) return false;
+    lock_pa(pa);
+    bool is_successful = remove_block(pa, idx);
+    unlock_pa(pa);
+    return is_successful;
+}
+
+int pa_save(PointersArray *pa, char* block) {
+    if (block == NULL) {
+        fprintf(stderr, "Error: Cannot load a file to the pointers array. Wrong input parameter.\n");
         return -1;
     }
-    // Look for an empty index
-    for (int i = 0; i < pa->length; i++) {
-        if (pa->array[i] == NULL) return i;
+    return save_block(pa, block, (long) strlen(block), NULL, false);
+}
+
+int pa_save_owned(PointersArray *pa, char* block, long length) {
+    if (block == NULL || length < 0) {
+        fprintf(stderr, "Error: Cannot load a file to the pointers array. Wrong input parameter.\n");
+        return -1;
     }
-    return -1;
+    return save_block(pa, block, length, NULL, true);
 }
 
-bool create_block_at_index(char* block, int idx) {
+static int save_block(PointersArray *pa, char* block, long length, StatsRecords *records, bool is_owned) {
+    if (!does_pa_exist(pa)) return -1;
+    // Find an empty index and store a block there in one critical section,
+    // so that concurrent calls never claim the same slot
+    lock_pa(pa);
+    int idx = find_empty_slot(pa);
+    // Return if there is no empty space remaining in the PointersArray
+    if (idx < 0) {
+        unlock_pa(pa);
+        fprintf(stderr, "Error: Cannot load a file to the pointers array. No enough empty space.\n");
+        return -1;
+    }
+    // Save the file content block
+    if (!create_block(pa, block, length, records, idx, is_owned)) idx = -1;
+    unlock_pa(pa);
+
+    return idx;
+}
+
+char* pa_get(PointersArray *pa, int idx) {
+    if (pa == NULL) return NULL;
+    // A block of a shared table can be removed or moved as soon as the lock
+    // is released, so it can only be read in pa_visit()
+    if (pa->is_shared) {
+        fprintf(stderr, "Error: Cannot return a block of a shared pointers array. Use pa_visit() instead.\n");
+        return NULL;
+    }
+    return find_slot_block(pa, idx);
+}
+
+bool pa_visit(PointersArray *pa, int idx, BlockVisitor visit, void* arg) {
+    if (!does_pa_exist(pa) || visit == NULL) return false;
+    lock_pa(pa);
+    bool is_used = idx >= 0 && idx < pa->length && is_slot_used(pa, idx);
+    // The visitor runs in the critical section, so the block and records
+    // cannot be changed by other threads until it returns
+    if (is_used) visit(find_slot_block(pa, idx), pa->records[idx], arg);
+    unlock_pa(pa);
+    return is_used;
+}
+
+bool pa_compact(PointersArray *pa) {
     if (pa == NULL) {
-        fprintf(stderr, "Error: Cannot free a pointers array. Pointers array does not exist.\n");
+        fprintf(stderr, "Error: Cannot compact a pointers array. Pointers array does not exist.\n");
         return false;
     }
-    // Return false if function input parameters are incorrect
-    if (block == NULL || idx < 0 || idx >= pa->length) {
-        fprintf(stderr, "Error: Cannot create a memory block. Wrong input parameters.\n");
-        return false;
+    lock_pa(pa);
+    compact_arena(pa);
+    unlock_pa(pa);
+    return true;
+}
+
+int pa_save_files_stats(PointersArray *pa, char** paths, int no_paths, BlockFormat format) {
+    if (!does_pa_exist(pa) || !check_paths(paths, no_paths)) return -1;
+    // Count files only once and create both representations from the result
+    FileStats* stats = count_files_stats(paths, no_paths);
+    if (stats == NULL) return -1;
+
+    char* block = NULL;
+    long length = 0;
+    StatsRecords *records = NULL;
+    if (format != BLOCK_FORMAT_RECORDS) block = create_stats_block(stats, paths, no_paths, &length);
+    if (format != BLOCK_FORMAT_TEXT) records = create_stats_records(stats, paths, no_paths);
+    free(stats);
+
+    int idx = -1;
+    if ((format == BLOCK_FORMAT_RECORDS || block != NULL) && (format == BLOCK_FORMAT_TEXT || records != NULL)) {
+        idx = save_block(pa, block, length, records, true);
+    }
+    // Both representations stay owned by this function if they weren't saved
+    if (idx < 0) {
+        free(block);
+        free(records);
+    }
+    return idx;
+}
+
+StatsRecords* pa_get_records(PointersArray *pa, int idx) {
+    if (pa == NULL) return NULL;
+    if (pa->is_shared) {
+        fprintf(stderr, "Error: Cannot return records of a shared pointers array. Use pa_visit() instead.\n");
+        return NULL;
     }
-    // Save the block at the specified index
-    pa->array[idx] = (char*) calloc(strlen(block) + 1, sizeof(char));
-    strcpy(pa->array[idx], block);
+    if (idx < 0 || idx >= pa->length || !is_slot_used(pa, idx)) return NULL;
+    return pa->records[idx];
+}
 
+long pa_sum_column(PointersArray *pa, StatsColumn column) {
+    FileStats sum;
+    if (!pa_sum_stats(pa, &sum)) return -1;
+    switch (column) {
+        case STATS_COLUMN_LINES:
+            return sum.no_lines;
+        case STATS_COLUMN_WORDS:
+            return sum.no_words;
+        case STATS_COLUMN_BYTES:
+            return sum.no_bytes;
+        default:
+            fprintf(stderr, "Error: Unknown statistics column.\n");
+            return -1;
+    }
+}
+
+bool pa_sum_stats(PointersArray *pa, FileStats *sum) {
+    if (!does_pa_exist(pa) || sum == NULL) return false;
+    // Sums are kept up to date by save and remove operations, so stored
+    // blocks are neither visited nor parsed again
+    lock_pa(pa);
+    *sum = pa->records_total;
+    unlock_pa(pa);
     return true;
 }
 
-bool remove_block_at_index(int idx) {
+static bool does_pa_exist(PointersArray *pa) {
     if (pa == NULL) {
-        fprintf(stderr, "Error: Cannot free a pointers array. Pointers array does not exist.\n");
+        fprintf(stderr, "Error: Pointers array does not exist.\n");
+        return false;
+    }
+    return true;
+}
+
+static void lock_pa(PointersArray *pa) {
+    if (pa->is_shared) pthread_mutex_lock(&pa->mutex);
+}
+
+static void unlock_pa(PointersArray *pa) {
+    if (pa->is_shared) pthread_mutex_unlock(&pa->mutex);
+}
+
+static char* find_slot_block(PointersArray *pa, int idx) {
+    if (idx < 0 || idx >= pa->length || !is_slot_used(pa, idx)) return NULL;
+    // Blocks stored in the arena are valid until the next block is saved
+    // or the pointers array is compacted
+    // (slots which hold only statistics records have no text block)
+    if (pa->storage_mode == STORAGE_MODE_ARENA) {
+        if (pa->offsets[idx] < 0) return NULL;
+        return pa->arena + pa->offsets[idx] + sizeof(ArenaRecord);
+    }
+    return pa->array[idx];
+}
+
+static void free_pa_arrays(PointersArray *pa) {
+    // Free the array pointer, records, the arena and bitmaps
+    free(pa->array);
+    free(pa->records);
+    free(pa->arena);
+    free(pa->offsets);
+    free(pa->used_slots);
+    free(pa->full_words);
+}
+
+static int find_empty_slot(PointersArray *pa) {
+    // Look for the first word of the bitmap with an empty slot and then for
+    // the first empty slot in this word (the lowest empty index is returned)
+    int no_summary_words = (pa->no_words + 63) / 64;
+    for (int i = 0; i < no_summary_words; i++) {
+        if (pa->full_words[i] == UINT64_MAX) continue;
+        int word_idx = i * 64 + __builtin_ctzll(~pa->full_words[i]);
+        return word_idx * 64 + __builtin_ctzll(~pa->used_slots[word_idx]);
+    }
+    return -1;
+}
+
+static bool create_block(PointersArray *pa, char* block, long length, StatsRecords *records, int idx,
+                         bool is_owned) {
+    // Return false if function input parameters are incorrect
+    if (idx < 0 || idx >= pa->length || (block == NULL && records == NULL)) {
+        fprintf(stderr, "Error: Cannot create a memory block. Wrong input parameters.\n");
         return false;
     }
+    // Replace the block which is already stored at this index
+    if (is_slot_used(pa, idx)) remove_block(pa, idx);
+    // Save the block at the specified index (an owned block is stored
+    // without copying unless it has to be moved to the arena)
+    if (block == NULL) {
+        if (pa->storage_mode == STORAGE_MODE_ARENA) pa->offsets[idx] = -1;
+    } else if (pa->storage_mode == STORAGE_MODE_ARENA) {
+        if (!append_arena_record(pa, block, (int) length, idx)) return false;
+        if (is_owned) free(block);
+    } else if (is_owned) {
+        pa->array[idx] = block;
+    } else {
+        pa->array[idx] = (char*) calloc(length + 1, sizeof(char));
+        memcpy(pa->array[idx], block, length + 1);
+    }
+    // Records are always owned by the pointers array
+    if (records != NULL) {
+        pa->records[idx] = records;
+        add_records_total(pa, records, 1);
+    }
+    mark_slot_used(pa, idx);
+
+    return true;
+}
+
+static bool remove_block(PointersArray *pa, int idx) {
     // Return false if function input parameters are incorrect
-    if (idx < 0 || idx >= pa->length || pa->array[idx] == NULL) {
+    if (idx < 0 || idx >= pa->length || !is_slot_used(pa, idx)) {
         fprintf(stderr, "Error: Cannot remove a memory block. Wrong input parameter.\n");
         return false;
     }
-    // Remove a block (chars array) from the specified index
-    free(pa->array[idx]);
-    pa->array[idx] = NULL;
+    // Remove a block (chars array) from the specified index or mark
+    // its arena record as a tombstone
+    if (pa->storage_mode == STORAGE_MODE_ARENA) {
+        if (pa->offsets[idx] >= 0) {
+            ArenaRecord *record = (ArenaRecord*) (pa->arena + pa->offsets[idx]);
+            record->idx = -1;
+            pa->no_dead_bytes += calc_record_size(record->length);
+        }
+    } else {
+        free(pa->array[idx]);
+        pa->array[idx] = NULL;
+    }
+    // Remove statistics records and subtract them from the columns sums
+    if (pa->records[idx] != NULL) {
+        add_records_total(pa, pa->records[idx], -1);
+        free(pa->records[idx]);
+        pa->records[idx] = NULL;
+    }
+    mark_slot_empty(pa, idx);
 
     return true;
 }
 
-int save_string_block(char* block) {
-    if (block == NULL) {
-        fprintf(stderr, "Error: Cannot load a file to the pointers array. Wrong input parameter.\n");
-        return -1;
+static void add_records_total(PointersArray *pa, StatsRecords *records, int sign) {
+    for (int i = 0; i < records->no_records; i++) {
+        pa->records_total.no_lines += sign * records->records[i].fs.no_lines;
+        pa->records_total.no_words += sign * records->records[i].fs.no_words;
+        pa->records_total.no_bytes += sign * records->records[i].fs.no_bytes;
     }
-    // Find an index where a new block can be stored
-    int idx = find_empty_index();
-    // Return if there is no empty space remaining in the PointersArray
-    if (idx < 0) {
-        fprintf(stderr, "Error: Cannot load a file to the pointers array. No enough empty space.\n");
-        return -1;
+}
+
+static void mark_slot_used(PointersArray *pa, int idx) {
+    int word_idx = idx / 64;
+    pa->used_slots[word_idx] |= 1ULL << (idx % 64);
+    if (pa->used_slots[word_idx] == UINT64_MAX) pa->full_words[word_idx / 64] |= 1ULL << (word_idx % 64);
+}
+
+static void mark_slot_empty(PointersArray *pa, int idx) {
+    int word_idx = idx / 64;
+    pa->used_slots[word_idx] &= ~(1ULL << (idx % 64));
+    pa->full_words[word_idx / 64] &= ~(1ULL << (word_idx % 64));
+}
+
+static bool is_slot_used(PointersArray *pa, int idx) {
+    return (pa->used_slots[idx / 64] >> (idx % 64)) & 1;
+}
+
+static void compact_arena(PointersArray *pa) {
+    // Blocks allocated on the heap don't leave any space to reclaim
+    if (pa->storage_mode != STORAGE_MODE_ARENA || pa->no_dead_bytes == 0) return;
+
+    // Move records of existing blocks over tombstones preserving their order
+    long read_offset = 0, write_offset = 0;
+    while (read_offset < pa->arena_size) {
+        ArenaRecord *record = (ArenaRecord*) (pa->arena + read_offset);
+        long record_size = calc_record_size(record->length);
+        if (record->idx >= 0) {
+            if (write_offset != read_offset) memmove(pa->arena + write_offset, record, record_size);
+            pa->offsets[((ArenaRecord*) (pa->arena + write_offset))->idx] = write_offset;
+            write_offset += record_size;
+        }
+        read_offset += record_size;
     }
-    // Save the file content block
-    create_block_at_index(block, idx);
+    pa->arena_size = write_offset;
+    pa->no_dead_bytes = 0;
+}
 
-    return idx;
+static long calc_record_size(int length) {
+    long size = (long) sizeof(ArenaRecord) + length + 1;
+    return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+static bool reserve_arena_space(PointersArray *pa, long size) {
+    if (pa->arena_size + size <= pa->arena_capacity) return true;
+    // Reclaim space of removed blocks first if they take at least
+    // a half of the arena
+    if (pa->no_dead_bytes >= pa->arena_size / 2) {
+        compact_arena(pa);
+        if (pa->arena_size + size <= pa->arena_capacity) return true;
+    }
+    // Otherwise, grow the arena
+    long capacity = pa->arena_capacity;
+    while (pa->arena_size + size > capacity) capacity *= 2;
+    char* arena = (char*) realloc(pa->arena, capacity);
+    if (arena == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return false;
+    }
+    pa->arena = arena;
+    pa->arena_capacity = capacity;
+    return true;
+}
+
+static bool append_arena_record(PointersArray *pa, char* block, int length, int idx) {
+    long record_size = calc_record_size(length);
+    if (!reserve_arena_space(pa, record_size)) return false;
+
+    ArenaRecord *record = (ArenaRecord*) (pa->arena + pa->arena_size);
+    record->length = length;
+    record->idx = idx;
+    memcpy(pa->arena + pa->arena_size + sizeof(ArenaRecord), block, length + 1);
+    pa->offsets[idx] = pa->arena_size;
+    pa->arena_size += record_size;
+
+    return true;
+}
+
+/*
+ * Default PointersArray (used by functions which don't take a handle)
+ */
+bool create_pointers_array(int length) {
+    if (default_pa != NULL) {
+        fprintf(stderr, "Error: Pointers array already exist. Remove the existing pointers array first.\n");
+        return false;
+    }
+    default_pa = pa_create(length, storage_mode, false);
+    return default_pa != NULL;
+}
+
+bool free_pointers_array() {
+    bool is_successful = pa_free(default_pa);
+    default_pa = NULL;
+    return is_successful;
+}
+
+int find_empty_index() {
+    return pa_find_empty_index(default_pa);
+}
+
+bool create_block_at_index(char* block, int idx) {
+    return pa_create_block_at_index(default_pa, block, idx);
+}
+
+bool remove_block_at_index(int idx) {
+    return pa_remove(default_pa, idx);
+}
+
+int save_string_block(char* block) {
+    return pa_save(default_pa, block);
+}
+
+int save_owned_string_block(char* block, long length) {
+    return pa_save_owned(default_pa, block, length);
+}
+
+char* get_block_at_index(int idx) {
+    return pa_get(default_pa, idx);
+}
+
+bool compact_pointers_array() {
+    return pa_compact(default_pa);
+}
+
+int save_files_stats(char** paths, int no_paths, BlockFormat format) {
+    return pa_save_files_stats(default_pa, paths, no_paths, format);
+}
+
+StatsRecords* get_records_at_index(int idx) {
+    return pa_get_records(default_pa, idx);
+}
+
+long sum_stats_column(StatsColumn column) {
+    return pa_sum_column(default_pa, column);
+}
+
+bool sum_stats(FileStats *sum) {
+    return pa_sum_stats(default_pa, sum);
 }
 
 /*
@@ -121,15 +674,747 @@ bool does_file_exist(char* path) {
     return false;
 }
 
+void set_stats_mode(StatsMode mode) {
+    stats_mode = mode;
+}
+
+StatsMode get_stats_mode() {
+    return stats_mode;
+}
+
+bool set_stats_kernel(StatsKernel kernel) {
+    #ifdef SIMD_STATS_KERNELS
+        __builtin_cpu_init();
+        bool has_sse2 = __builtin_cpu_supports("sse2");
+        bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    #else
+        bool has_sse2 = false;
+        bool has_avx2 = false;
+    #endif
+
+    // Choose the fastest kernel supported by the CPU
+    if (kernel == STATS_KERNEL_AUTO) {
+        if (has_avx2) kernel = STATS_KERNEL_AVX2;
+        else if (has_sse2) kernel = STATS_KERNEL_SSE2;
+        else kernel = STATS_KERNEL_SCALAR;
+    }
+
+    if ((kernel == STATS_KERNEL_SSE2 && !has_sse2) || (kernel == STATS_KERNEL_AVX2 && !has_avx2)) {
+        fprintf(stderr, "Error: The selected statistics kernel is not supported by the CPU.\n");
+        return false;
+    }
+
+    switch (kernel) {
+        #ifdef SIMD_STATS_KERNELS
+        case STATS_KERNEL_SSE2:
+            count_buffer_stats = count_buffer_stats_sse2;
+            break;
+        case STATS_KERNEL_AVX2:
+            count_buffer_stats = count_buffer_stats_avx2;
+            break;
+        #endif
+        default:
+            count_buffer_stats = count_buffer_stats_scalar;
+    }
+    stats_kernel = kernel;
+
+    return true;
+}
+
+StatsKernel get_stats_kernel() {
+    if (count_buffer_stats == NULL) set_stats_kernel(STATS_KERNEL_AUTO);
+    return stats_kernel;
+}
+
+bool set_stats_threads(int no_threads) {
+    if (no_threads < 0 || no_threads > MAX_STATS_THREADS) {
+        fprintf(stderr, "Error: Cannot use %d statistics threads.\n", no_threads);
+        return false;
+    }
+    // Don't replace the pool while a job is being counted
+    pthread_mutex_lock(&stats_pool.job_mutex);
+    bool is_successful = start_stats_pool(no_threads);
+    pthread_mutex_unlock(&stats_pool.job_mutex);
+    return is_successful;
+}
+
+int get_stats_threads() {
+    return stats_pool.no_threads > 1 ? stats_pool.no_threads : 1;
+}
+
+static bool start_stats_pool(int no_threads) {
+    // Remove the previous pool (files are counted sequentially if
+    // less than 2 threads are requested)
+    stop_stats_pool();
+    if (no_threads < 2) return true;
+
+    // Select the kernel before workers start using it
+    if (count_buffer_stats == NULL) set_stats_kernel(STATS_KERNEL_AUTO);
+
+    stats_pool.threads = (pthread_t*) calloc(no_threads, sizeof(pthread_t));
+    if (stats_pool.threads == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return false;
+    }
+    stats_pool.stop = false;
+    // Workers wait for jobs posted after the current generation (the
+    // generation isn't reset, so a new pool mustn't start from 0)
+    intptr_t generation = stats_pool.generation;
+    for (int i = 0; i < no_threads; i++) {
+        if (pthread_create(&stats_pool.threads[i], NULL, stats_worker, (void*) generation) != 0) {
+            fprintf(stderr, "Error: Cannot create a statistics thread.\n");
+            stop_stats_pool();
+            return false;
+        }
+        stats_pool.no_threads++;
+    }
+
+    return true;
+}
+
+static void stop_stats_pool() {
+    if (stats_pool.threads == NULL) return;
+
+    pthread_mutex_lock(&stats_pool.mutex);
+    stats_pool.stop = true;
+    pthread_cond_broadcast(&stats_pool.job_cond);
+    pthread_mutex_unlock(&stats_pool.mutex);
+
+    for (int i = 0; i < stats_pool.no_threads; i++) pthread_join(stats_pool.threads[i], NULL);
+    free(stats_pool.threads);
+    stats_pool.threads = NULL;
+    stats_pool.no_threads = 0;
+}
+
+static void* stats_worker(void* arg) {
+    char* buffer = (char*) malloc(STATS_BUFFER_SIZE);
+    int generation = (int) (intptr_t) arg;
+
+    while (true) {
+        // Wait for a new job
+        pthread_mutex_lock(&stats_pool.mutex);
+        while (!stats_pool.stop && stats_pool.generation == generation) {
+            pthread_cond_wait(&stats_pool.job_cond, &stats_pool.mutex);
+        }
+        if (stats_pool.stop) {
+            pthread_mutex_unlock(&stats_pool.mutex);
+            break;
+        }
+        generation = stats_pool.generation;
+        pthread_mutex_unlock(&stats_pool.mutex);
+
+        // Take ranges until all of them are counted
+        int idx;
+        while ((idx = __atomic_fetch_add(&stats_pool.next_range, 1, __ATOMIC_RELAXED)) < stats_pool.no_ranges) {
+            StatsRange *range = &stats_pool.ranges[idx];
+            if (buffer == NULL) range->is_successful = false;
+            else count_range_stats(stats_pool.paths, range, buffer);
+        }
+
+        // Let the caller know when the last worker has finished
+        pthread_mutex_lock(&stats_pool.mutex);
+        if (--stats_pool.no_active == 0) pthread_cond_signal(&stats_pool.done_cond);
+        pthread_mutex_unlock(&stats_pool.mutex);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+void set_stats_cache_limit(long limit) {
+    pthread_mutex_lock(&stats_cache.mutex);
+    stats_cache.limit = limit > 0 ? limit : 0;
+    evict_cache_entries(stats_cache.limit);
+    pthread_mutex_unlock(&stats_cache.mutex);
+}
+
+bool get_stats_cache_info(StatsCacheInfo *info) {
+    if (info == NULL) return false;
+    pthread_mutex_lock(&stats_cache.mutex);
+    info->no_hits = stats_cache.no_hits;
+    info->no_misses = stats_cache.no_misses;
+    info->no_entries = stats_cache.no_entries;
+    info->size = stats_cache.size;
+    info->limit = stats_cache.limit;
+    pthread_mutex_unlock(&stats_cache.mutex);
+    return true;
+}
+
+void clear_stats_cache() {
+    pthread_mutex_lock(&stats_cache.mutex);
+    evict_cache_entries(0);
+    stats_cache.no_hits = 0;
+    stats_cache.no_misses = 0;
+    pthread_mutex_unlock(&stats_cache.mutex);
+}
+
 char* get_files_stats(char** paths, int no_paths) {
+    return get_files_stats_with_length(paths, no_paths, NULL);
+}
+
+char* get_files_stats_with_length(char** paths, int no_paths, long *length) {
+    if (!check_paths(paths, no_paths)) return NULL;
+    long block_length;
+    char* block;
+    if (stats_mode == STATS_MODE_SHELL) block = get_files_stats_shell(paths, no_paths, &block_length);
+    else block = get_files_stats_native(paths, no_paths, &block_length);
+    if (block != NULL && length != NULL) *length = block_length;
+    return block;
+}
+
+static bool check_paths(char** paths, int no_paths) {
     // Check if input parameters are correct
-    if (paths == NULL || no_paths <= 0) return NULL;
+    if (paths == NULL || no_paths <= 0) return false;
     for (int i = 0; i < no_paths; i++) {
         if (!does_file_exist(paths[i])) {
             fprintf(stderr, "Error: File '%s' does not exist.\n", paths[i]);
-            return NULL;
+            return false;
         }
     }
+    return true;
+}
+
+bool count_file_stats(char* path, FileStats *fs) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open the file '%s'.\n", path);
+        return false;
+    }
+    // The file is read once from the beginning to the end
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    char* buffer = (char*) malloc(STATS_BUFFER_SIZE);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        close(fd);
+        return false;
+    }
+
+    // Count lines, words and bytes in a single pass over the file
+    if (count_buffer_stats == NULL) set_stats_kernel(STATS_KERNEL_AUTO);
+    fs->no_lines = fs->no_words = fs->no_bytes = 0;
+    bool in_word = false;
+    bool is_successful = count_fd_stats(fd, 0, -1, buffer, fs, &in_word, NULL);
+
+    free(buffer);
+    close(fd);
+
+    if (!is_successful) fprintf(stderr, "Error: Cannot read the file '%s'.\n", path);
+    return is_successful;
+}
+
+static bool count_fd_stats(int fd, long offset, long length, char* buffer, FileStats *fs, bool *in_word,
+                           ByteClass *first_class) {
+    long read_length;
+
+    while (length != 0) {
+        // Read the whole file sequentially or only the specified range
+        if (length < 0) {
+            read_length = (long) read(fd, buffer, STATS_BUFFER_SIZE);
+        } else {
+            long size = length < STATS_BUFFER_SIZE ? length : STATS_BUFFER_SIZE;
+            read_length = (long) pread(fd, buffer, size, offset);
+            if (read_length > 0) length -= read_length;
+        }
+        if (read_length < 0) return false;
+        if (read_length == 0) break;
+        offset += read_length;
+
+        // Find a class of the first byte which is not a control byte
+        for (long i = 0; first_class != NULL && *first_class == BYTE_CLASS_NONE && i < read_length; i++) {
+            unsigned char c = (unsigned char) buffer[i];
+            if (c == ' ' || (c >= '\t' && c <= '\r')) *first_class = BYTE_CLASS_SPACE;
+            else if (c > ' ' && c < 0x7f) *first_class = BYTE_CLASS_PRINT;
+        }
+
+        count_buffer_stats(buffer, read_length, fs, in_word);
+        fs->no_bytes += read_length;
+    }
+
+    return true;
+}
+
+static void count_buffer_stats_scalar(char* buffer, long length, FileStats *fs, bool *in_word) {
+    // Words are counted in the same way as wc does in the C locale: whitespace
+    // characters end a word, printable characters start a new one and the
+    // remaining (control) characters neither start nor end a word
+    long no_lines = 0, no_words = 0;
+    bool is_in_word = *in_word;
+
+    for (long i = 0; i < length; i++) {
+        unsigned char c = (unsigned char) buffer[i];
+        if (c == '\n') no_lines++;
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            is_in_word = false;
+        } else if (c > ' ' && c < 0x7f && !is_in_word) {
+            is_in_word = true;
+            no_words++;
+        }
+    }
+
+    fs->no_lines += no_lines;
+    fs->no_words += no_words;
+    *in_word = is_in_word;
+}
+
+#ifdef SIMD_STATS_KERNELS
+/*
+ * SIMD kernels classify 64 bytes at a time into bit masks (bit i describes
+ * the i-th byte of a block). A word starts at every printable byte which
+ * follows a whitespace byte, so when a block contains only whitespace and
+ * printable bytes, words are counted with a single popcount. Blocks with
+ * control or non-ASCII bytes fall back to the scalar kernel.
+ */
+static inline void count_block_masks(char* block, uint64_t nl_mask, uint64_t space_mask, uint64_t print_mask,
+                                     FileStats *fs, bool *in_word) {
+    if ((space_mask | print_mask) != UINT64_MAX) {
+        count_buffer_stats_scalar(block, 64, fs, in_word);
+        return;
+    }
+    uint64_t prev_print_mask = (print_mask << 1) | (uint64_t) *in_word;
+    fs->no_lines += __builtin_popcountll(nl_mask);
+    fs->no_words += __builtin_popcountll(print_mask & ~prev_print_mask);
+    *in_word = (print_mask >> 63) != 0;
+}
+
+__attribute__((target("sse2")))
+static void count_buffer_stats_sse2(char* buffer, long length, FileStats *fs, bool *in_word) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i space_min = _mm_set1_epi8('\t' - 1);
+    const __m128i space_max = _mm_set1_epi8('\r' + 1);
+    const __m128i print_max = _mm_set1_epi8(0x7f);
+
+    long i = 0;
+    for (; i + 64 <= length; i += 64) {
+        uint64_t nl_mask = 0, space_mask = 0, print_mask = 0;
+        for (int j = 0; j < 4; j++) {
+            __m128i v = _mm_loadu_si128((__m128i*) (buffer + i + 16 * j));
+            // Bytes >= 0x80 are negative in signed comparisons, so they
+            // are classified neither as whitespace nor as printable
+            __m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                            _mm_and_si128(_mm_cmpgt_epi8(v, space_min),
+                                                          _mm_cmpgt_epi8(space_max, v)));
+            __m128i is_print = _mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmpgt_epi8(print_max, v));
+            nl_mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)) << (16 * j);
+            space_mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(is_space) << (16 * j);
+            print_mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(is_print) << (16 * j);
+        }
+        count_block_masks(buffer + i, nl_mask, space_mask, print_mask, fs, in_word);
+    }
+
+    count_buffer_stats_scalar(buffer + i, length - i, fs, in_word);
+}
+
+__attribute__((target("avx2,popcnt")))
+static void count_buffer_stats_avx2(char* buffer, long length, FileStats *fs, bool *in_word) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i space_min = _mm256_set1_epi8('\t' - 1);
+    const __m256i space_max = _mm256_set1_epi8('\r' + 1);
+    const __m256i print_max = _mm256_set1_epi8(0x7f);
+
+    long i = 0;
+    for (; i + 64 <= length; i += 64) {
+        uint64_t nl_mask = 0, space_mask = 0, print_mask = 0;
+        for (int j = 0; j < 2; j++) {
+            __m256i v = _mm256_loadu_si256((__m256i*) (buffer + i + 32 * j));
+            __m256i is_space = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                               _mm256_and_si256(_mm256_cmpgt_epi8(v, space_min),
+                                                                _mm256_cmpgt_epi8(space_max, v)));
+            __m256i is_print = _mm256_and_si256(_mm256_cmpgt_epi8(v, space), _mm256_cmpgt_epi8(print_max, v));
+            nl_mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)) << (32 * j);
+            space_mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(is_space) << (32 * j);
+            print_mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(is_print) << (32 * j);
+        }
+        count_block_masks(buffer + i, nl_mask, space_mask, print_mask, fs, in_word);
+    }
+
+    count_buffer_stats_scalar(buffer + i, length - i, fs, in_word);
+}
+#endif
+
+static char* get_files_stats_native(char** paths, int no_paths, long *length) {
+    FileStats* stats = count_files_stats(paths, no_paths);
+    if (stats == NULL) return NULL;
+    char* block = create_stats_block(stats, paths, no_paths, length);
+    free(stats);
+    return block;
+}
+
+static FileStats* count_files_stats(char** paths, int no_paths) {
+    // The last element holds the total statistics
+    FileStats* stats = (FileStats*) calloc(no_paths + 1, sizeof(FileStats));
+    if (stats == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return NULL;
+    }
+
+    // Take statistics of unchanged files from the cache and count only
+    // the remaining files
+    struct stat* sbs = (struct stat*) calloc(no_paths, sizeof(struct stat));
+    char** missed_paths = (char**) calloc(no_paths, sizeof(char*));
+    int* missed_idxs = (int*) calloc(no_paths, sizeof(int));
+    FileStats* missed_stats = (FileStats*) calloc(no_paths, sizeof(FileStats));
+    bool is_successful = sbs != NULL && missed_paths != NULL && missed_idxs != NULL && missed_stats != NULL;
+    if (!is_successful) fprintf(stderr, "Error: failed to allocate memory\n");
+
+    int no_missed = 0;
+    for (int i = 0; is_successful && i < no_paths; i++) {
+        if (find_cached_stats(paths[i], &sbs[i], &stats[i])) continue;
+        missed_paths[no_missed] = paths[i];
+        missed_idxs[no_missed++] = i;
+    }
+
+    // Count files one after another or hand them over to the workers
+    if (is_successful && no_missed > 0) {
+        if (stats_pool.no_threads > 1) {
+            is_successful = count_files_stats_parallel(missed_paths, no_missed, missed_stats);
+        } else {
+            for (int j = 0; is_successful && j < no_missed; j++) {
+                is_successful = count_file_stats(missed_paths[j], &missed_stats[j]);
+            }
+        }
+    }
+    for (int j = 0; is_successful && j < no_missed; j++) {
+        stats[missed_idxs[j]] = missed_stats[j];
+        cache_stats(missed_paths[j], &sbs[missed_idxs[j]], &missed_stats[j]);
+    }
+
+    free(sbs);
+    free(missed_paths);
+    free(missed_idxs);
+    free(missed_stats);
+    if (!is_successful) {
+        free(stats);
+        return NULL;
+    }
+
+    FileStats *total = &stats[no_paths];
+    for (int i = 0; i < no_paths; i++) {
+        total->no_lines += stats[i].no_lines;
+        total->no_words += stats[i].no_words;
+        total->no_bytes += stats[i].no_bytes;
+    }
+    return stats;
+}
+
+static bool count_files_stats_parallel(char** paths, int no_paths, FileStats *stats) {
+    int no_ranges;
+    StatsRange *ranges = create_stats_ranges(paths, no_paths, &no_ranges);
+    if (ranges == NULL) return false;
+
+    // Post a new job and wait until all workers finish it (the pool
+    // counts one job at a time, so concurrent callers wait for their turn)
+    pthread_mutex_lock(&stats_pool.job_mutex);
+    if (stats_pool.no_threads < 2) {
+        // The pool was removed in the meantime
+        pthread_mutex_unlock(&stats_pool.job_mutex);
+        free(ranges);
+        for (int i = 0; i < no_paths; i++) {
+            if (!count_file_stats(paths[i], &stats[i])) return false;
+        }
+        return true;
+    }
+    pthread_mutex_lock(&stats_pool.mutex);
+    stats_pool.paths = paths;
+    stats_pool.ranges = ranges;
+    stats_pool.no_ranges = no_ranges;
+    stats_pool.next_range = 0;
+    stats_pool.no_active = stats_pool.no_threads;
+    stats_pool.generation++;
+    pthread_cond_broadcast(&stats_pool.job_cond);
+    while (stats_pool.no_active > 0) pthread_cond_wait(&stats_pool.done_cond, &stats_pool.mutex);
+    stats_pool.ranges = NULL;
+    pthread_mutex_unlock(&stats_pool.mutex);
+    pthread_mutex_unlock(&stats_pool.job_mutex);
+
+    // Merge ranges statistics (ranges of each file are stored in order)
+    bool is_successful = true;
+    bool in_word = false;
+    for (int i = 0; i < no_ranges; i++) {
+        StatsRange *range = &ranges[i];
+        FileStats *fs = &stats[range->file_idx];
+        if (!range->is_successful) {
+            fprintf(stderr, "Error: Cannot read the file '%s'.\n", paths[range->file_idx]);
+            is_successful = false;
+            break;
+        }
+        // Every file starts outside of a word
+        if (i == 0 || ranges[i - 1].file_idx != range->file_idx) in_word = false;
+        // Don't count twice a word which was started in the previous range
+        if (in_word && range->first_class == BYTE_CLASS_PRINT) fs->no_words--;
+        if (range->first_class != BYTE_CLASS_NONE) in_word = range->ends_in_word;
+
+        fs->no_lines += range->fs.no_lines;
+        fs->no_words += range->fs.no_words;
+        fs->no_bytes += range->fs.no_bytes;
+    }
+
+    free(ranges);
+    return is_successful;
+}
+
+static StatsRange* create_stats_ranges(char** paths, int no_paths, int *no_ranges) {
+    // Get files sizes to calculate the number of ranges
+    long* sizes = (long*) calloc(no_paths, sizeof(long));
+    if (sizes == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return NULL;
+    }
+    struct stat sb;
+    int count = 0;
+    for (int i = 0; i < no_paths; i++) {
+        // Files which are not regular are read till EOF as a single range
+        if (stat(paths[i], &sb) == 0 && S_ISREG(sb.st_mode)) {
+            sizes[i] = sb.st_size;
+            count += sb.st_size > 0 ? (int) ((sb.st_size - 1) / STATS_RANGE_SIZE) + 1 : 1;
+        } else {
+            sizes[i] = -1;
+            count++;
+        }
+    }
+
+    StatsRange *ranges = (StatsRange*) calloc(count, sizeof(StatsRange));
+    if (ranges == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        free(sizes);
+        return NULL;
+    }
+
+    // Split files into ranges
+    int idx = 0;
+    for (int i = 0; i < no_paths; i++) {
+        long offset = 0;
+        do {
+            ranges[idx].file_idx = i;
+            ranges[idx].offset = offset;
+            if (sizes[i] < 0) ranges[idx].length = -1;
+            else if (sizes[i] - offset < STATS_RANGE_SIZE) ranges[idx].length = sizes[i] - offset;
+            else ranges[idx].length = STATS_RANGE_SIZE;
+            offset += STATS_RANGE_SIZE;
+            idx++;
+        } while (offset < sizes[i]);
+    }
+
+    free(sizes);
+    *no_ranges = count;
+    return ranges;
+}
+
+static void count_range_stats(char** paths, StatsRange *range, char* buffer) {
+    int fd = open(paths[range->file_idx], O_RDONLY);
+    if (fd < 0) {
+        range->is_successful = false;
+        return;
+    }
+    bool in_word = false;
+    range->is_successful = count_fd_stats(fd, range->offset, range->length, buffer,
+                                          &range->fs, &in_word, &range->first_class);
+    range->ends_in_word = in_word;
+    close(fd);
+}
+
+static bool find_cached_stats(char* path, struct stat *sb, FileStats *fs) {
+    // Files aren't even checked with stat() if the cache is disabled
+    pthread_mutex_lock(&stats_cache.mutex);
+    bool is_enabled = stats_cache.limit > 0;
+    pthread_mutex_unlock(&stats_cache.mutex);
+    if (!is_enabled || stat(path, sb) != 0 || !S_ISREG(sb->st_mode)) {
+        sb->st_mode = 0;
+        return false;
+    }
+
+    pthread_mutex_lock(&stats_cache.mutex);
+    StatsCacheEntry *entry = find_cache_entry(path, hash_path(path));
+    bool is_hit = false;
+    if (entry != NULL) {
+        is_hit = entry->dev == sb->st_dev && entry->ino == sb->st_ino && entry->size == sb->st_size &&
+                 entry->mtime.tv_sec == sb->st_mtim.tv_sec && entry->mtime.tv_nsec == sb->st_mtim.tv_nsec;
+        if (is_hit) {
+            // Move the entry to the front of the LRU list
+            *fs = entry->fs;
+            unlink_lru_entry(entry);
+            link_lru_entry(entry);
+        } else {
+            // The file has changed, so its entry is no longer valid
+            remove_cache_entry(entry);
+        }
+    }
+    if (is_hit) stats_cache.no_hits++;
+    else stats_cache.no_misses++;
+
+    pthread_mutex_unlock(&stats_cache.mutex);
+    return is_hit;
+}
+
+static void cache_stats(char* path, struct stat *sb, FileStats *fs) {
+    // Skip files which couldn't be checked and files modified during the
+    // last second, as another write within the same timestamp wouldn't
+    // change their modification time
+    if (sb->st_mode == 0 || sb->st_mtim.tv_sec >= time(NULL) - 1) return;
+
+    long size = sizeof(StatsCacheEntry) + strlen(path) + 1;
+    pthread_mutex_lock(&stats_cache.mutex);
+    if (size > stats_cache.limit) {
+        pthread_mutex_unlock(&stats_cache.mutex);
+        return;
+    }
+    // Replace an entry saved in the meantime by another thread
+    uint64_t hash = hash_path(path);
+    StatsCacheEntry *entry = find_cache_entry(path, hash);
+    if (entry != NULL) remove_cache_entry(entry);
+
+    entry = (StatsCacheEntry*) malloc(size);
+    if (entry != NULL) {
+        strcpy(entry->path, path);
+        entry->hash = hash;
+        entry->dev = sb->st_dev;
+        entry->ino = sb->st_ino;
+        entry->size = sb->st_size;
+        entry->mtime = sb->st_mtim;
+        entry->fs = *fs;
+        // Insert the entry to its bucket and to the front of the LRU list
+        StatsCacheEntry **bucket = &stats_cache.buckets[hash % STATS_CACHE_BUCKETS];
+        entry->next = *bucket;
+        *bucket = entry;
+        link_lru_entry(entry);
+        stats_cache.no_entries++;
+        stats_cache.size += size;
+        evict_cache_entries(stats_cache.limit);
+    }
+    pthread_mutex_unlock(&stats_cache.mutex);
+}
+
+static StatsCacheEntry* find_cache_entry(char* path, uint64_t hash) {
+    StatsCacheEntry *entry = stats_cache.buckets[hash % STATS_CACHE_BUCKETS];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->path, path) != 0)) entry = entry->next;
+    return entry;
+}
+
+static void remove_cache_entry(StatsCacheEntry *entry) {
+    // Remove the entry from its bucket
+    StatsCacheEntry **prev = &stats_cache.buckets[entry->hash % STATS_CACHE_BUCKETS];
+    while (*prev != entry) prev = &(*prev)->next;
+    *prev = entry->next;
+
+    unlink_lru_entry(entry);
+    stats_cache.no_entries--;
+    stats_cache.size -= sizeof(StatsCacheEntry) + strlen(entry->path) + 1;
+    free(entry);
+}
+
+static void evict_cache_entries(long limit) {
+    // Remove the least recently used entries until the cache fits the limit
+    while (stats_cache.lru_last != NULL && stats_cache.size > limit) remove_cache_entry(stats_cache.lru_last);
+}
+
+static void link_lru_entry(StatsCacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = stats_cache.lru_first;
+    if (stats_cache.lru_first != NULL) stats_cache.lru_first->lru_prev = entry;
+    else stats_cache.lru_last = entry;
+    stats_cache.lru_first = entry;
+}
+
+static void unlink_lru_entry(StatsCacheEntry *entry) {
+    if (entry->lru_prev != NULL) entry->lru_prev->lru_next = entry->lru_next;
+    else stats_cache.lru_first = entry->lru_next;
+    if (entry->lru_next != NULL) entry->lru_next->lru_prev = entry->lru_prev;
+    else stats_cache.lru_last = entry->lru_prev;
+}
+
+static uint64_t hash_path(char* path) {
+    // FNV-1a hash
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *path != '\0'; path++) {
+        hash ^= (unsigned char) *path;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int calc_stats_width(char** paths, int no_paths) {
+    // wc aligns columns to the number of digits of the total size of
+    // regular files and uses at least 7 digits if any file is not regular
+    long total_size = 0;
+    int min_width = 1;
+    struct stat sb;
+
+    for (int i = 0; i < no_paths; i++) {
+        if (stat(paths[i], &sb) == 0 && S_ISREG(sb.st_mode)) total_size += sb.st_size;
+        else min_width = 7;
+    }
+
+    int width = 1;
+    while ((total_size /= 10) > 0) width++;
+    return width > min_width ? width : min_width;
+}
+
+static int print_stats_line(char* buffer, int size, FileStats *fs, int width, char* name) {
+    return snprintf(buffer, size, "%*ld %*ld %*ld %s\n",
+                    width, fs->no_lines,
+                    width, fs->no_words,
+                    width, fs->no_bytes,
+                    name);
+}
+
+static char* create_stats_block(FileStats *stats, char** paths, int no_paths, long *block_length) {
+    int width = calc_stats_width(paths, no_paths);
+    // wc prints the total line only if more than one file was counted
+    int no_lines = no_paths > 1 ? no_paths + 1 : no_paths;
+
+    // Calculate a length of the result string
+    int length = 0;
+    for (int i = 0; i < no_lines; i++) {
+        char* name = i < no_paths ? paths[i] : "total";
+        length += print_stats_line(NULL, 0, &stats[i], width, name);
+    }
+
+    // Create the result string
+    char* block = (char*) calloc(length + 1, sizeof(char));
+    if (block == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return NULL;
+    }
+
+    int offset = 0;
+    for (int i = 0; i < no_lines; i++) {
+        char* name = i < no_paths ? paths[i] : "total";
+        offset += print_stats_line(block + offset, length + 1 - offset, &stats[i], width, name);
+    }
+    *block_length = length;
+
+    return block;
+}
+
+static StatsRecords* create_stats_records(FileStats *stats, char** paths, int no_paths) {
+    // Records and paths are stored in one allocation after the struct, so
+    // they are freed with a single free() call
+    long size = sizeof(StatsRecords) + no_paths * sizeof(StatsRecord);
+    for (int i = 0; i < no_paths; i++) size += strlen(paths[i]) + 1;
+    StatsRecords *records = (StatsRecords*) calloc(1, size);
+    if (records == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return NULL;
+    }
+    records->no_records = no_paths;
+    records->records = (StatsRecord*) (records + 1);
+
+    char* path = (char*) (records->records + no_paths);
+    struct stat sb;
+    for (int i = 0; i < no_paths; i++) {
+        StatsRecord *record = &records->records[i];
+        strcpy(path, paths[i]);
+        record->path = path;
+        record->fs = stats[i];
+        record->mtime = stat(paths[i], &sb) == 0 ? sb.st_mtime : 0;
+        path += strlen(paths[i]) + 1;
+    }
+    return records;
+}
+
+static char* get_files_stats_shell(char** paths, int no_paths, long *block_length) {
     // Create a temporary file
     char path_buffer[32] = TEMP_FILE_TEMPLATE;
     int path_length = strlen(TEMP_FILE_TEMPLATE);
@@ -165,6 +1450,7 @@ char* get_files_stats(char** paths, int no_paths) {
         free(block);
         return NULL;
     }
+    *block_length = length;
 
     return block;
 }
@@ -192,3 +1478,34 @@ char* create_cmd(char* temp_path, char** paths, int no_paths) {
     strcat(cmd, temp_path);
     return cmd;
 }
+
+/*
+ * Function table
+ */
+const SysOpsApi sysops_api = {
+    .version = LIBSYSOPS_API_VERSION,
+    .size = sizeof(SysOpsApi),
+    .create_pointers_array = create_pointers_array,
+    .free_pointers_array = free_pointers_array,
+    .find_empty_index = find_empty_index,
+    .create_block_at_index = create_block_at_index,
+    .remove_block_at_index = remove_block_at_index,
+    .save_string_block = save_string_block,
+    .save_owned_string_block = save_owned_string_block,
+    .get_block_at_index = get_block_at_index,
+    .compact_pointers_array = compact_pointers_array,
+    .set_storage_mode = set_storage_mode,
+    .save_files_stats = save_files_stats,
+    .get_records_at_index = get_records_at_index,
+    .sum_stats_column = sum_stats_column,
+    .sum_stats = sum_stats,
+    .set_stats_mode = set_stats_mode,
+    .set_stats_kernel = set_stats_kernel,
+    .set_stats_threads = set_stats_threads,
+    .set_stats_cache_limit = set_stats_cache_limit,
+    .get_stats_cache_info = get_stats_cache_info,
+    .clear_stats_cache = clear_stats_cache,
+    .get_files_stats = get_files_stats,
+    .get_files_stats_with_length = get_files_stats_with_length,
+    .count_file_stats = count_file_stats
+};
@@ -1,16 +1,194 @@
 #ifndef LIBSYSOPS_H
 #define LIBSYSOPS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
 #define TEMP_FILE_TEMPLATE "/tmp/sysops-tempXXXXXX"
+#define STATS_BUFFER_SIZE (128 * 1024)
+#define STATS_RANGE_SIZE (16 * 1024 * 1024)
+#define MAX_STATS_THREADS 64
+#define ARENA_INITIAL_SIZE (64 * 1024)
+#define STATS_CACHE_DEFAULT_LIMIT (1024 * 1024)
+#define STATS_CACHE_BUCKETS 4096
+#define LIBSYSOPS_API_VERSION 1
+#define LIBSYSOPS_API_SYMBOL "sysops_api"
 
 /*
- * PointersArray
+ * Structs
  */
+typedef enum {
+    STORAGE_MODE_HEAP,  // Every block is allocated separately with calloc()
+    STORAGE_MODE_ARENA  // Blocks are length-prefixed records in one region
+} StorageMode;
+
+typedef struct {
+    long no_lines;
+    long no_words;
+    long no_bytes;
+} FileStats;
+
+typedef struct {
+    long no_hits;
+    long no_misses;
+    long no_entries;
+    long size;   // Memory used by the cached entries in bytes
+    long limit;
+} StatsCacheInfo;
+
+typedef struct {
+    char *path;
+    FileStats fs;
+    time_t mtime;
+} StatsRecord;
+
+typedef struct {
+    int no_records;
+    StatsRecord *records;  // Allocated together with the struct and paths
+} StatsRecords;
+
+typedef enum {
+    BLOCK_FORMAT_TEXT,     // Store only the text block printed by wc
+    BLOCK_FORMAT_RECORDS,  // Store only the statistics records
+    BLOCK_FORMAT_BOTH      // Store the text block and the statistics records
+} BlockFormat;
+
+typedef enum {
+    STATS_COLUMN_LINES,
+    STATS_COLUMN_WORDS,
+    STATS_COLUMN_BYTES
+} StatsColumn;
+
+// Called with a block (NULL if the slot holds only records) and its
+// records (NULL if the slot holds only text)
+typedef void (*BlockVisitor)(char* block, StatsRecords *records, void* arg);
+
 typedef struct {
     int length;
     char **array;
+    // Bitmap of used slots (a set bit means a used slot) and a summary
+    // bitmap of its words which have no empty slot left
+    uint64_t *used_slots;
+    uint64_t *full_words;
+    int no_words;
+    // Arena storage (blocks are referenced by offsets instead of pointers,
+    // because the arena can be moved when it grows)
+    StorageMode storage_mode;
+    char *arena;
+    long *offsets;
+    long arena_size;
+    long arena_capacity;
+    long no_dead_bytes;  // Size of records of removed blocks
+    // Statistics records stored next to (or instead of) the text blocks and
+    // the sums of their columns, which are updated when blocks are saved
+    // or removed
+    StatsRecords **records;
+    FileStats records_total;
+    // Tables shared by many threads lock the mutex in every operation
+    bool is_shared;
+    pthread_mutex_t mutex;
 } PointersArray;
 
+typedef enum {
+    STATS_MODE_NATIVE,  // Count lines, words and bytes in the library
+    STATS_MODE_SHELL    // Run wc through system() and read its output back
+} StatsMode;
+
+typedef enum {
+    STATS_KERNEL_AUTO,    // Use the fastest kernel supported by the CPU
+    STATS_KERNEL_SCALAR,  // Classify bytes one at a time
+    STATS_KERNEL_SSE2,    // Classify 64 bytes at a time with SSE2
+    STATS_KERNEL_AVX2     // Classify 64 bytes at a time with AVX2
+} StatsKernel;
+
+// Table of the default PointersArray and files functions, which programs
+// loading the library with dlopen() can fetch with a single dlsym() call of
+// LIBSYSOPS_API_SYMBOL. New functions are only appended to the end of the
+// table, so it is compatible with every program which was compiled with
+// the same version and a size not greater than the size of the table.
+typedef struct {
+    int version;
+    int size;
+    // Default PointersArray
+    bool  (*create_pointers_array)(int length);
+    bool  (*free_pointers_array)(void);
+    int   (*find_empty_index)(void);
+    bool  (*create_block_at_index)(char* block, int idx);
+    bool  (*remove_block_at_index)(int idx);
+    int   (*save_string_block)(char* block);
+    int   (*save_owned_string_block)(char* block, long length);
+    char* (*get_block_at_index)(int idx);
+    bool  (*compact_pointers_array)(void);
+    void  (*set_storage_mode)(StorageMode mode);
+    int   (*save_files_stats)(char** paths, int no_paths, BlockFormat format);
+    StatsRecords* (*get_records_at_index)(int idx);
+    long  (*sum_stats_column)(StatsColumn column);
+    bool  (*sum_stats)(FileStats *sum);
+    // Files
+    void  (*set_stats_mode)(StatsMode mode);
+    bool  (*set_stats_kernel)(StatsKernel kernel);
+    bool  (*set_stats_threads)(int no_threads);
+    void  (*set_stats_cache_limit)(long limit);
+    bool  (*get_stats_cache_info)(StatsCacheInfo *info);
+    void  (*clear_stats_cache)(void);
+    char* (*get_files_stats)(char** paths, int no_paths);
+    char* (*get_files_stats_with_length)(char** paths, int no_paths, long *length);
+    bool  (*count_file_stats)(char* path, FileStats *fs);
+} SysOpsApi;
+
+// Programs loading the library with dlopen() define LIBSYSOPS_TYPES_ONLY
+// to get the structs without the functions prototypes
+#ifndef LIBSYSOPS_TYPES_ONLY
+
+/*
+ * PointersArray
+ */
+void set_storage_mode(StorageMode mode);
+
+PointersArray* pa_create(int length, StorageMode mode, bool is_shared);
+
+bool pa_free(PointersArray *pa);
+
+int pa_find_empty_index(PointersArray *pa);
+
+bool pa_create_block_at_index(PointersArray *pa, char* block, int idx);
+
+bool pa_remove(PointersArray *pa, int idx);
+
+int pa_save(PointersArray *pa, char* block);
+
+// Takes ownership of a heap-allocated block of the given length (without
+// '\0'), which is stored without copying. The block stays owned by the
+// caller if it cannot be saved.
+int pa_save_owned(PointersArray *pa, char* block, long length);
+
+// Returns NULL for shared tables, whose blocks have to be read in pa_visit()
+char* pa_get(PointersArray *pa, int idx);
+
+// Calls visit() with the block and records stored at the index while the
+// table is locked. Returns false if the slot is empty.
+bool pa_visit(PointersArray *pa, int idx, BlockVisitor visit, void* arg);
+
+bool pa_compact(PointersArray *pa);
+
+// Counts the files in the library (in any stats mode) and stores their
+// statistics as a text block, records or both in one slot
+int pa_save_files_stats(PointersArray *pa, char** paths, int no_paths, BlockFormat format);
+
+// Returns NULL for shared tables (see pa_visit())
+StatsRecords* pa_get_records(PointersArray *pa, int idx);
+
+// Sums a column of the records of all stored blocks (blocks saved only as
+// text are not included)
+long pa_sum_column(PointersArray *pa, StatsColumn column);
+
+bool pa_sum_stats(PointersArray *pa, FileStats *sum);
+
+/*
+ * Default PointersArray
+ */
 bool create_pointers_array(int length);
 
 bool free_pointers_array();
@@ -23,11 +201,53 @@ bool remove_block_at_index(int idx);
 
 int save_string_block(char* block);
 
+int save_owned_string_block(char* block, long length);
+
+char* get_block_at_index(int idx);
+
+bool compact_pointers_array();
+
+int save_files_stats(char** paths, int no_paths, BlockFormat format);
+
+StatsRecords* get_records_at_index(int idx);
+
+long sum_stats_column(StatsColumn column);
+
+bool sum_stats(FileStats *sum);
+
 /*
  * Files
  */
+void set_stats_mode(StatsMode mode);
+
+StatsMode get_stats_mode();
+
+bool set_stats_kernel(StatsKernel kernel);
+
+StatsKernel get_stats_kernel();
+
+bool set_stats_threads(int no_threads);
+
+int get_stats_threads();
+
+// Statistics of unchanged regular files are taken from a cache of at most
+// limit bytes (a limit of 0 disables the cache). The cache isn't used if
+// files are counted by wc in STATS_MODE_SHELL.
+void set_stats_cache_limit(long limit);
+
+bool get_stats_cache_info(StatsCacheInfo *info);
+
+void clear_stats_cache();
+
 char* get_files_stats(char** paths, int no_paths);
 
+// Returns the same block as get_files_stats() and stores its length
+char* get_files_stats_with_length(char** paths, int no_paths, long *length);
+
+bool count_file_stats(char* path, FileStats *fs);
+
 bool does_file_exist(char* path);
 
+#endif // LIBSYSOPS_TYPES_ONLY
+
 #endif // LIBSYSOPS_H
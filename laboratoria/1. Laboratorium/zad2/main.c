@@ -11,30 +11,84 @@
 #define CREATE_TABLE_CMD "create_table"
 #define WC_FILES_CMD "wc_files"
 #define REMOVE_BLOCK_CMD "remove_block"
+#define RUN_SCRIPT_CMD "run_script"
+
+#define STDIN_PATH "-"
+#define TOKEN_INITIAL_SIZE 64
+#define SCRIPT_INITIAL_ARGS 16
 
 
 #ifdef DYNAMIC_MODE
     #include <dlfcn.h>
+    #define LIBSYSOPS_TYPES_ONLY
+    #include LIB_HEADER_PATH
 
     bool  (*create_pointers_array)(int);
     bool  (*free_pointers_array)(void);
     bool  (*remove_block_at_index)(int);
     int   (*save_string_block)(char*);
     char* (*get_files_stats)(char**, int);
+    char* (*get_files_stats_with_length)(char**, int, long*);
+    int   (*save_owned_string_block)(char*, long);
+    void  (*set_stats_mode)(StatsMode);
+    bool  (*set_stats_threads)(int);
+    void  (*set_storage_mode)(StorageMode);
+    void  (*set_stats_cache_limit)(long);
+    bool  (*get_stats_cache_info)(StatsCacheInfo*);
+    void  (*clear_stats_cache)(void);
+
+    // Bind all symbols of the library when it is loaded instead of when
+    // functions are called for the first time
+    #ifdef EAGER_BINDING
+        #define DLOPEN_FLAGS RTLD_NOW
+    #else
+        #define DLOPEN_FLAGS RTLD_LAZY
+    #endif
 
     void* load_my_lib() {
-        void *lib_handle = dlopen(LIB_SHARED_PATH, RTLD_LAZY);
+        void *lib_handle = dlopen(LIB_SHARED_PATH, DLOPEN_FLAGS);
 
         if (lib_handle == NULL) {
             fprintf(stderr, "Error: Cannot load the dynamic library '%s'\n", LIB_SHARED_PATH);
             exit(1);
         }
 
-        create_pointers_array = dlsym(lib_handle, "create_pointers_array");
-        free_pointers_array = dlsym(lib_handle, "free_pointers_array");
-        remove_block_at_index = dlsym(lib_handle, "remove_block_at_index");
-        save_string_block = dlsym(lib_handle, "save_string_block");
-        get_files_stats = dlsym(lib_handle, "get_files_stats");
+        // Get all functions from the versioned table with a single lookup
+        #ifdef FUNCTION_TABLE
+            const SysOpsApi *api = dlsym(lib_handle, LIBSYSOPS_API_SYMBOL);
+            if (api == NULL || api->version != LIBSYSOPS_API_VERSION || api->size < (int) sizeof(SysOpsApi)) {
+                fprintf(stderr, "Error: The dynamic library '%s' has an incompatible function table\n", LIB_SHARED_PATH);
+                exit(1);
+            }
+
+            create_pointers_array = api->create_pointers_array;
+            free_pointers_array = api->free_pointers_array;
+            remove_block_at_index = api->remove_block_at_index;
+            save_string_block = api->save_string_block;
+            get_files_stats = api->get_files_stats;
+            get_files_stats_with_length = api->get_files_stats_with_length;
+            save_owned_string_block = api->save_owned_string_block;
+            set_stats_mode = api->set_stats_mode;
+            set_stats_threads = api->set_stats_threads;
+            set_storage_mode = api->set_storage_mode;
+            set_stats_cache_limit = api->set_stats_cache_limit;
+            get_stats_cache_info = api->get_stats_cache_info;
+            clear_stats_cache = api->clear_stats_cache;
+        #else
+            create_pointers_array = dlsym(lib_handle, "create_pointers_array");
+            free_pointers_array = dlsym(lib_handle, "free_pointers_array");
+            remove_block_at_index = dlsym(lib_handle, "remove_block_at_index");
+            save_string_block = dlsym(lib_handle, "save_string_block");
+            get_files_stats = dlsym(lib_handle, "get_files_stats");
+            get_files_stats_with_length = dlsym(lib_handle, "get_files_stats_with_length");
+            save_owned_string_block = dlsym(lib_handle, "save_owned_string_block");
+            set_stats_mode = dlsym(lib_handle, "set_stats_mode");
+            set_stats_threads = dlsym(lib_handle, "set_stats_threads");
+            set_storage_mode = dlsym(lib_handle, "set_storage_mode");
+            set_stats_cache_limit = dlsym(lib_handle, "set_stats_cache_limit");
+            get_stats_cache_info = dlsym(lib_handle, "get_stats_cache_info");
+            clear_stats_cache = dlsym(lib_handle, "clear_stats_cache");
+        #endif
 
         return lib_handle;
     }
@@ -45,12 +99,46 @@
 #ifdef MEASURE_TIME
     #include <sys/times.h>
     #include <unistd.h>
+    #include <stdint.h>
+    #include <inttypes.h>
+    #include <time.h>
+
+    // Latencies are recorded in log-linear histograms: values below
+    // LATENCY_SUB_BUCKETS ns have their own buckets and every higher power
+    // of 2 is split into LATENCY_SUB_BUCKETS buckets (6.25% precision)
+    #define LATENCY_SUB_BUCKETS 16
+    #define LATENCY_SUB_BITS 4
+    #define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+    #define NO_HISTOGRAMS 4
+    #define LOAD_LIBRARY_CMD "load_library"
+    #ifndef LATENCY_CSV_PATH
+        #define LATENCY_CSV_PATH "latency.csv"
+    #endif
+
+    typedef struct {
+        char* cmd;
+        long count;
+        uint64_t max;
+        long buckets[LATENCY_BUCKETS];
+    } LatencyHistogram;
+
+    LatencyHistogram histograms[NO_HISTOGRAMS] = {
+        {.cmd = CREATE_TABLE_CMD},
+        {.cmd = WC_FILES_CMD},
+        {.cmd = REMOVE_BLOCK_CMD},
+        {.cmd = LOAD_LIBRARY_CMD}
+    };
+
+    // Path of the first executed script (saved in the CSV file)
+    char* latency_script_path = NULL;
 
     struct tms tms_start_buffer, tms_end_buffer;
     clock_t clock_t_start, clock_t_end;
+    struct timespec ts_start, ts_end;
 
     struct tms tms_start_buffer_total;
     clock_t clock_t_start_total;
+    struct timespec ts_start_total;
 
     bool started_first_measurement = false;
 
@@ -58,16 +146,63 @@
         clock_t_start = times(&tms_start_buffer);
         if (!started_first_measurement) {
             clock_t_start_total = times(&tms_start_buffer_total);
+            clock_gettime(CLOCK_MONOTONIC, &ts_start_total);
             started_first_measurement = true;
         }
+        clock_gettime(CLOCK_MONOTONIC, &ts_start);
     }
 
     void stop_timer() {
+        clock_gettime(CLOCK_MONOTONIC, &ts_end);
         clock_t_end = times(&tms_end_buffer);
     }
 
+    uint64_t calc_latency(struct timespec *end, struct timespec *start) {
+        return (uint64_t) (end->tv_sec - start->tv_sec) * 1000000000 + end->tv_nsec - start->tv_nsec;
+    }
+
+    int calc_latency_bucket(uint64_t latency) {
+        if (latency < LATENCY_SUB_BUCKETS) return (int) latency;
+        int exponent = 63 - __builtin_clzll(latency);
+        int sub_bucket = (int) (latency >> (exponent - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+        return (exponent - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub_bucket;
+    }
+
+    uint64_t calc_bucket_upper_bound(int bucket) {
+        if (bucket < LATENCY_SUB_BUCKETS) return (uint64_t) bucket;
+        int exponent = bucket / LATENCY_SUB_BUCKETS + LATENCY_SUB_BITS - 1;
+        uint64_t sub_bucket = bucket % LATENCY_SUB_BUCKETS;
+        return ((LATENCY_SUB_BUCKETS + sub_bucket + 1) << (exponent - LATENCY_SUB_BITS)) - 1;
+    }
+
+    void record_latency(char* cmd) {
+        for (int i = 0; i < NO_HISTOGRAMS; i++) {
+            if (strcmp(histograms[i].cmd, cmd) != 0) continue;
+            uint64_t latency = calc_latency(&ts_end, &ts_start);
+            histograms[i].buckets[calc_latency_bucket(latency)]++;
+            histograms[i].count++;
+            if (latency > histograms[i].max) histograms[i].max = latency;
+            return;
+        }
+    }
+
+    uint64_t calc_percentile(LatencyHistogram *histogram, int permille) {
+        // Returns the upper bound of the bucket holding the percentile (but
+        // never more than the maximum latency)
+        long rank = (histogram->count * permille + 999) / 1000;
+        long count = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            count += histogram->buckets[i];
+            if (count >= rank && count > 0) {
+                uint64_t bound = calc_bucket_upper_bound(i);
+                return bound < histogram->max ? bound : histogram->max;
+            }
+        }
+        return histogram->max;
+    }
+
     void print_times_headers() {
-        printf("               %-10s %-10s %-10s\n", "Real", "System", "User");
+        printf("               %-10s %-10s %-10s %-10s\n", "Real", "System", "User", "Wall [us]");
     }
 
     void print_time(double time) {
@@ -85,6 +220,7 @@
         print_time(calc_time(clock_t_end, clock_t_start));
         print_time(calc_time(tms_end_buffer.tms_stime, tms_start_buffer.tms_stime));
         print_time(calc_time(tms_end_buffer.tms_cutime, tms_start_buffer.tms_cutime));
+        print_time(calc_latency(&ts_end, &ts_start) / 1000.0);
         printf("\n");
     }
 
@@ -93,8 +229,52 @@
         print_time(calc_time(clock_t_end, clock_t_start_total));
         print_time(calc_time(tms_end_buffer.tms_stime, tms_start_buffer_total.tms_stime));
         print_time(calc_time(tms_end_buffer.tms_cutime, tms_start_buffer_total.tms_cutime));
+        print_time(calc_latency(&ts_end, &ts_start_total) / 1000.0);
         printf("\n");
     }
+
+    void print_latency_histograms() {
+        printf("\n%-15s%-10s %-10s %-10s %-10s %-10s\n", "Latency [us]", "Count", "p50", "p90", "p99", "Max");
+        for (int i = 0; i < NO_HISTOGRAMS; i++) {
+            LatencyHistogram *histogram = &histograms[i];
+            if (histogram->count == 0) continue;
+            printf("%-15s%-10ld ", histogram->cmd, histogram->count);
+            print_time(calc_percentile(histogram, 500) / 1000.0);
+            print_time(calc_percentile(histogram, 900) / 1000.0);
+            print_time(calc_percentile(histogram, 990) / 1000.0);
+            print_time(histogram->max / 1000.0);
+            printf("\n");
+        }
+    }
+
+    void write_latency_csv(char* program) {
+        // Rows of subsequent runs are appended to the same file
+        FILE* file = fopen(LATENCY_CSV_PATH, "a");
+        if (file == NULL) {
+            fprintf(stderr, "Error: Cannot open the file '%s'.\n", LATENCY_CSV_PATH);
+            return;
+        }
+        if (ftell(file) == 0) fprintf(file, "program,script,command,count,p50_ns,p90_ns,p99_ns,max_ns\n");
+        for (int i = 0; i < NO_HISTOGRAMS; i++) {
+            LatencyHistogram *histogram = &histograms[i];
+            if (histogram->count == 0) continue;
+            fprintf(file, "%s,%s,%s,%ld,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                    program, latency_script_path != NULL ? latency_script_path : "", histogram->cmd,
+                    histogram->count,
+                    calc_percentile(histogram, 500),
+                    calc_percentile(histogram, 900),
+                    calc_percentile(histogram, 990),
+                    histogram->max);
+        }
+        fclose(file);
+    }
+
+    void print_cache_stats() {
+        StatsCacheInfo info;
+        if (!get_stats_cache_info(&info)) return;
+        printf("%-15s%ld hits, %ld misses (%ld entries, %ld bytes)\n", "CACHE",
+               info.no_hits, info.no_misses, info.no_entries, info.size);
+    }
 #endif
 
 void exec_cmd(int *i, int argc, char** argv);
@@ -110,6 +290,10 @@ char** get_files_paths_args(int *i, int argc, char** argv, int no_args);
 void handle_remove_block(int *i, int argc, char** argv);
 int get_removed_block_idx(int *i, int argc, char** argv);
 
+void handle_run_script(int *i, int argc, char** argv);
+void run_script(FILE* file);
+char* read_token(FILE* file);
+
 int parse_int(char* str);
 bool is_cmd_arg(char* arg);
 bool is_number(const char* arg);
@@ -123,8 +307,37 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // Measure the startup cost of the library loading strategy
     #ifdef DYNAMIC_MODE
+        #ifdef MEASURE_TIME
+            clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        #endif
         void *lib_handle = load_my_lib();
+        #ifdef MEASURE_TIME
+            clock_gettime(CLOCK_MONOTONIC, &ts_end);
+            record_latency(LOAD_LIBRARY_CMD);
+        #endif
+    #endif
+
+    // Run wc in a shell instead of counting in the library (reference mode)
+    #ifdef SHELL_STATS
+        set_stats_mode(STATS_MODE_SHELL);
+    #endif
+
+    // Store blocks in a single arena instead of separate heap allocations
+    #ifdef ARENA_STORAGE
+        set_storage_mode(STORAGE_MODE_ARENA);
+    #endif
+
+    // Limit memory used by cached statistics to STATS_CACHE_LIMIT bytes
+    // (0 disables the cache)
+    #ifdef STATS_CACHE_LIMIT
+        set_stats_cache_limit(STATS_CACHE_LIMIT);
+    #endif
+
+    // Count files of each block on STATS_THREADS worker threads
+    #ifdef STATS_THREADS
+        if (!set_stats_threads(STATS_THREADS)) return 1;
     #endif
 
     #ifdef MEASURE_TIME
@@ -135,9 +348,18 @@ int main(int argc, char** argv) {
 
     #ifdef MEASURE_TIME
         print_total_times();
+        print_cache_stats();
+        print_latency_histograms();
+        write_latency_csv(argv[0]);
+        free(latency_script_path);
     #endif
 
     free_pointers_array();
+    clear_stats_cache();
+
+    #ifdef STATS_THREADS
+        set_stats_threads(0);
+    #endif
 
     #ifdef DYNAMIC_MODE
         dlclose(lib_handle);
@@ -190,17 +412,29 @@ void handle_wc_files(int *i, int argc, char** argv) {
     }
 
     char** paths = get_files_paths_args(i, argc, argv, no_args);
-    char* stats = get_files_stats(paths, no_args);
-    free_array(paths, no_args);
 
-    if (save_string_block(stats) < 0) {
+    // Hand the statistics block over to the table instead of copying it
+    #ifdef ZERO_COPY_BLOCKS
+        long length;
+        char* stats = get_files_stats_with_length(paths, no_args, &length);
+        free_array(paths, no_args);
+        bool was_saved = stats != NULL && save_owned_string_block(stats, length) >= 0;
+    #else
+        char* stats = get_files_stats(paths, no_args);
+        free_array(paths, no_args);
+        bool was_saved = save_string_block(stats) >= 0;
+    #endif
+
+    if (!was_saved) {
         fprintf(stderr, "Error: Cannot complete %s. Statistics block cannot be saved.\n", WC_FILES_CMD);
         free_pointers_array();
         free(stats);
         exit(1);
     }
 
-    free(stats);
+    #ifndef ZERO_COPY_BLOCKS
+        free(stats);
+    #endif
 }
 
 int get_removed_block_idx(int *i, int argc, char** argv) {
@@ -223,10 +457,81 @@ void handle_remove_block(int *i, int argc, char** argv) {
     }
 }
 
+void handle_run_script(int *i, int argc, char** argv) {
+    // Try to get the script path argument
+    char* path = get_next_arg(i, argc, argv);
+    if (path == NULL) {
+        fprintf(stderr, "Error: %s expected a script path (or '%s' for stdin).\n", RUN_SCRIPT_CMD, STDIN_PATH);
+        exit(1);
+    }
+
+    #ifdef MEASURE_TIME
+        // Arguments of nested scripts are freed when their line is executed
+        if (latency_script_path == NULL) latency_script_path = strdup(path);
+    #endif
+
+    FILE* file = strcmp(path, STDIN_PATH) == 0 ? stdin : fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot complete %s. Cannot open the script '%s'.\n", RUN_SCRIPT_CMD, path);
+        exit(1);
+    }
+    run_script(file);
+    if (file != stdin) fclose(file);
+}
+
+void run_script(FILE* file) {
+    // Every command is executed as soon as its arguments are read (when the
+    // next command or the end of the script is reached), so the script is
+    // never loaded into memory as a whole
+    int capacity = SCRIPT_INITIAL_ARGS;
+    int no_tokens = 0;
+    char** tokens = (char**) calloc(capacity, sizeof(char*));
+    char* token;
+
+    do {
+        token = read_token(file);
+        if (no_tokens > 0 && (token == NULL || !is_cmd_arg(token))) {
+            for (int j = 0; j < no_tokens; j++) exec_cmd(&j, no_tokens, tokens);
+            for (int j = 0; j < no_tokens; j++) free(tokens[j]);
+            no_tokens = 0;
+        }
+        if (token == NULL) break;
+        if (no_tokens == capacity) {
+            capacity *= 2;
+            tokens = (char**) realloc(tokens, capacity * sizeof(char*));
+        }
+        tokens[no_tokens++] = token;
+    } while (true);
+
+    free(tokens);
+}
+
+char* read_token(FILE* file) {
+    // Skip whitespace between tokens (including '\r' of CRLF scripts)
+    int c;
+    while ((c = getc(file)) != EOF && isspace(c));
+    if (c == EOF) return NULL;
+
+    int capacity = TOKEN_INITIAL_SIZE;
+    int length = 0;
+    char* token = (char*) malloc(capacity);
+    do {
+        if (length + 1 == capacity) {
+            capacity *= 2;
+            token = (char*) realloc(token, capacity);
+        }
+        token[length++] = (char) c;
+    } while ((c = getc(file)) != EOF && !isspace(c));
+    token[length] = '\0';
+
+    return token;
+}
+
 bool is_cmd_arg(char* arg) {
     return strcmp(arg, CREATE_TABLE_CMD) != 0 &&
            strcmp(arg, WC_FILES_CMD) != 0 &&
-           strcmp(arg, REMOVE_BLOCK_CMD) != 0;
+           strcmp(arg, REMOVE_BLOCK_CMD) != 0 &&
+           strcmp(arg, RUN_SCRIPT_CMD) != 0;
 }
 
 bool is_number(const char* arg) {
@@ -262,6 +567,12 @@ int parse_int(char* str) {
 }
 
 void exec_cmd(int *i, int argc, char** argv) {
+    // Commands of a script are measured separately
+    if (strcmp(argv[*i], RUN_SCRIPT_CMD) == 0) {
+        handle_run_script(i, argc, argv);
+        return;
+    }
+
     #ifdef MEASURE_TIME
         start_timer();
     #endif
@@ -281,6 +592,7 @@ void exec_cmd(int *i, int argc, char** argv) {
 
     #ifdef MEASURE_TIME
         stop_timer();
+        record_latency(cmd);
         #ifdef VERBOSE
             print_times(cmd);
         #endif
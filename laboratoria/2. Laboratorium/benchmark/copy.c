@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#ifdef LIB_SYS
+    #include "libcopysys.h"
+    #define LIB_NAME "copysys"
+#else
+    #include "libcopylib.h"
+    #define LIB_NAME "copylib"
+#endif
+
+
+#define RANDOM_SEED 2022
+#define GENERATE_BUFFER_SIZE (1024 * 1024)
+#define MAX_LINE_LENGTH (256 * 1024)
+#define MIN_BENCH_TIME 0.2  // Small files are copied many times for at least this time
+#define MAX_BENCH_RUNS 1000
+#define DEFAULT_MAX_COPY_TIME 10.0
+#define TARGET_FILE_NAME "target.txt"
+#define BYTES_IN_MB 1e6
+
+#define NO_SHAPES 4
+#define NO_SIZES 7
+#define NO_BUFFER_SIZES 3
+
+
+typedef enum {
+    SHAPE_SHORT,    // Lines of 8-80 characters, 10% of them blank
+    SHAPE_LONG,     // Lines of 16-256 KiB, 10% of them blank
+    SHAPE_BLANK,    // 90% of lines blank
+    SHAPE_NO_BLANK  // Lines of 8-80 characters without blank lines
+} Shape;
+
+typedef struct {
+    char* name;
+    CopyMode mode;
+    long buffer_size;  // 0 for modes which don't read through a buffer
+} Config;
+
+typedef struct {
+    int no_runs;
+    double time;
+    long no_reads;  // Read and write syscalls from /proc/self/io
+    long no_writes;
+    struct rusage usage;
+} Measurement;
+
+
+const char* SHAPE_NAMES[NO_SHAPES] = {"short", "long", "blank", "noblank"};
+const long SIZES[NO_SIZES] = {
+    1024L, 64 * 1024L, 1024 * 1024L, 16 * 1024 * 1024L,
+    256 * 1024 * 1024L, 1024 * 1024 * 1024L, 4 * 1024 * 1024 * 1024L
+};
+const long BUFFER_SIZES[NO_BUFFER_SIZES] = {4 * 1024L, 64 * 1024L, 1024 * 1024L};
+
+
+bool generate_inputs(char* dir, long max_size);
+bool generate_input(char* path, Shape shape, long size);
+long generate_line(char* line, Shape shape, uint64_t *state);
+bool run_benchmarks(char* dir, double max_time);
+int get_configs(Config *configs);
+bool measure_copy(Config *config, char* source_path, char* target_path, Measurement *m);
+bool reset_target(char* path);
+bool read_syscalls(long *no_reads, long *no_writes);
+uint64_t next_random(uint64_t *state);
+char* get_input_path(char* dir, Shape shape, long size, char* path, int length);
+char* get_size_str(long size, char* str, int length);
+double get_time();
+
+
+int main(int argc, char** argv) {
+    // Usage: copy generate <dir> <max size>
+    //        copy run <dir> [max copy time in seconds]
+    if (argc < 3) {
+        fprintf(stderr, "Error: Expected a command (generate or run) and a directory.\n");
+        return 1;
+    }
+    if (strcmp(argv[1], "generate") == 0) {
+        long max_size = argc > 3 ? strtol(argv[3], NULL, 10) : SIZES[NO_SIZES - 1];
+        return generate_inputs(argv[2], max_size) ? 0 : 1;
+    }
+    if (strcmp(argv[1], "run") == 0) {
+        double max_time = argc > 3 ? strtod(argv[3], NULL) : DEFAULT_MAX_COPY_TIME;
+        return run_benchmarks(argv[2], max_time) ? 0 : 1;
+    }
+    fprintf(stderr, "Error: Unknown command '%s'.\n", argv[1]);
+    return 1;
+}
+
+
+bool generate_inputs(char* dir, long max_size) {
+    if (mkdir(dir, 0755) < 0 && access(dir, W_OK) < 0) {
+        fprintf(stderr, "Error: Cannot create the directory '%s'.\n", dir);
+        return false;
+    }
+
+    char path[PATH_MAX];
+    for (int i = 0; i < NO_SHAPES; i++) {
+        for (int j = 0; j < NO_SIZES && SIZES[j] <= max_size; j++) {
+            get_input_path(dir, i, SIZES[j], path, PATH_MAX);
+            // Keep files generated before
+            struct stat sb;
+            if (stat(path, &sb) == 0 && sb.st_size == SIZES[j]) continue;
+            printf("Generating %s\n", path);
+            if (!generate_input(path, i, SIZES[j])) return false;
+        }
+    }
+    return true;
+}
+
+bool generate_input(char* path, Shape shape, long size) {
+    FILE* f_ptr = fopen(path, "w");
+    char* buffer = (char*) malloc(GENERATE_BUFFER_SIZE);
+    char* line = (char*) malloc(MAX_LINE_LENGTH + 2);
+    if (f_ptr == NULL || buffer == NULL || line == NULL) {
+        fprintf(stderr, "Error: Cannot create the file '%s'.\n", path);
+        if (f_ptr != NULL) fclose(f_ptr);
+        free(buffer);
+        free(line);
+        return false;
+    }
+    setvbuf(f_ptr, buffer, _IOFBF, GENERATE_BUFFER_SIZE);
+
+    // Files have exactly size bytes, so the last line is usually cut
+    uint64_t state = RANDOM_SEED + shape;
+    bool is_successful = true;
+    for (long written = 0; written < size && is_successful;) {
+        long length = generate_line(line, shape, &state);
+        if (length > size - written) length = size - written;
+        is_successful = fwrite(line, sizeof(char), length, f_ptr) == (size_t) length;
+        written += length;
+    }
+    if (fclose(f_ptr) != 0 || !is_successful) {
+        fprintf(stderr, "Error: Cannot write to the file '%s'.\n", path);
+        is_successful = false;
+    }
+    free(buffer);
+    free(line);
+    return is_successful;
+}
+
+long generate_line(char* line, Shape shape, uint64_t *state) {
+    const char whitespace[] = " \t";
+    const char text[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 ";
+
+    int blank_percent = shape == SHAPE_BLANK ? 90 : shape == SHAPE_NO_BLANK ? 0 : 10;
+    bool is_blank = (int) (next_random(state) % 100) < blank_percent;
+    long length;
+    if (is_blank) length = (long) (next_random(state) % 16);
+    else if (shape == SHAPE_LONG) length = 16 * 1024 + (long) (next_random(state) % (240 * 1024));
+    else length = 8 + (long) (next_random(state) % 73);
+
+    for (long i = 0; i < length; i++) {
+        line[i] = is_blank ? whitespace[next_random(state) % 2] : text[next_random(state) % (sizeof(text) - 1)];
+    }
+    // Non-blank lines start with a letter
+    if (!is_blank) line[0] = 'x';
+    line[length++] = '\r';
+    line[length++] = '\n';
+    return length;
+}
+
+bool run_benchmarks(char* dir, double max_time) {
+    Config configs[NO_BUFFER_SIZES + 2];
+    int no_configs = get_configs(configs);
+    char source_path[PATH_MAX], target_path[PATH_MAX], buffer_str[16], size_str[16];
+    snprintf(target_path, PATH_MAX, "%s/%s", dir, TARGET_FILE_NAME);
+
+    printf("%-8s %-10s %-8s %-8s %-8s %-6s %-10s %-12s %-12s %-10s %-10s\n", "Library", "Mode", "Buffer",
+           "Shape", "Size", "Runs", "MB/s", "Reads/run", "Writes/run", "Faults", "Switches");
+    for (int i = 0; i < no_configs; i++) {
+        Config *config = &configs[i];
+        for (int j = 0; j < NO_SHAPES; j++) {
+            // Larger files aren't copied if copying a file took too long
+            bool is_too_slow = false;
+            for (int k = 0; k < NO_SIZES && !is_too_slow; k++) {
+                get_input_path(dir, j, SIZES[k], source_path, PATH_MAX);
+                if (access(source_path, R_OK) < 0) continue;
+
+                Measurement m;
+                if (!measure_copy(config, source_path, target_path, &m)) return false;
+                double time_per_run = m.time / m.no_runs;
+                long no_faults = m.usage.ru_minflt + m.usage.ru_majflt;
+                long no_switches = m.usage.ru_nvcsw + m.usage.ru_nivcsw;
+                printf("%-8s %-10s %-8s %-8s %-8s %-6d %-10.2f %-12ld %-12ld %-10ld %-10ld\n", LIB_NAME,
+                       config->name, config->buffer_size > 0 ? get_size_str(config->buffer_size, buffer_str, 16) : "-",
+                       SHAPE_NAMES[j], get_size_str(SIZES[k], size_str, 16), m.no_runs,
+                       (double) SIZES[k] / BYTES_IN_MB / time_per_run, m.no_reads / m.no_runs,
+                       m.no_writes / m.no_runs, no_faults / m.no_runs, no_switches / m.no_runs);
+                fflush(stdout);
+                is_too_slow = time_per_run > max_time;
+            }
+        }
+    }
+
+    unlink(target_path);
+    return true;
+}
+
+int get_configs(Config *configs) {
+    int no_configs = 0;
+    for (int i = 0; i < NO_BUFFER_SIZES; i++) {
+        configs[no_configs++] = (Config) {"buffered", COPY_MODE_BUFFERED, BUFFER_SIZES[i]};
+    }
+    configs[no_configs++] = (Config) {"mapped", COPY_MODE_MAPPED, 0};
+    configs[no_configs++] = (Config) {"kernel", COPY_MODE_KERNEL, 0};
+    return no_configs;
+}
+
+bool measure_copy(Config *config, char* source_path, char* target_path, Measurement *m) {
+    set_copy_mode(config->mode);
+    set_read_buffer_size(config->buffer_size);
+    memset(m, 0, sizeof(Measurement));
+
+    struct rusage start_usage, end_usage;
+    long start_reads, start_writes, end_reads, end_writes;
+    getrusage(RUSAGE_SELF, &start_usage);
+    bool is_successful = read_syscalls(&start_reads, &start_writes);
+
+    // Copy a file to the empty target file (libcopysys doesn't truncate it)
+    while (is_successful && m->no_runs < MAX_BENCH_RUNS && (m->no_runs == 0 || m->time < MIN_BENCH_TIME)) {
+        if (!reset_target(target_path)) return false;
+        double start = get_time();
+        is_successful = copy_file(source_path, target_path);
+        m->time += get_time() - start;
+        m->no_runs++;
+    }
+
+    getrusage(RUSAGE_SELF, &end_usage);
+    if (!is_successful || !read_syscalls(&end_reads, &end_writes)) {
+        fprintf(stderr, "Error: Cannot copy the file '%s'.\n", source_path);
+        return false;
+    }
+    m->no_reads = end_reads - start_reads;
+    m->no_writes = end_writes - start_writes;
+    m->usage.ru_minflt = end_usage.ru_minflt - start_usage.ru_minflt;
+    m->usage.ru_majflt = end_usage.ru_majflt - start_usage.ru_majflt;
+    m->usage.ru_nvcsw = end_usage.ru_nvcsw - start_usage.ru_nvcsw;
+    m->usage.ru_nivcsw = end_usage.ru_nivcsw - start_usage.ru_nivcsw;
+    return true;
+}
+
+bool reset_target(char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create the file '%s'.\n", path);
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+bool read_syscalls(long *no_reads, long *no_writes) {
+    // getrusage() doesn't count syscalls, but the kernel counts read and
+    // write syscalls (including readv, writev, sendfile, copy_file_range)
+    // of every process
+    FILE* f_ptr = fopen("/proc/self/io", "r");
+    if (f_ptr == NULL) return false;
+    char name[32];
+    long value;
+    *no_reads = *no_writes = 0;
+    while (fscanf(f_ptr, "%31[^:]: %ld\n", name, &value) == 2) {
+        if (strcmp(name, "syscr") == 0) *no_reads = value;
+        else if (strcmp(name, "syscw") == 0) *no_writes = value;
+    }
+    fclose(f_ptr);
+    return true;
+}
+
+uint64_t next_random(uint64_t *state) {
+    // xorshift64
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+char* get_input_path(char* dir, Shape shape, long size, char* path, int length) {
+    char size_str[16];
+    snprintf(path, length, "%s/%s-%s.txt", dir, SHAPE_NAMES[shape], get_size_str(size, size_str, 16));
+    return path;
+}
+
+char* get_size_str(long size, char* str, int length) {
+    if (size >= 1024L * 1024 * 1024) snprintf(str, length, "%ldG", size / (1024L * 1024 * 1024));
+    else if (size >= 1024L * 1024) snprintf(str, length, "%ldM", size / (1024L * 1024));
+    else if (size >= 1024) snprintf(str, length, "%ldK", size / 1024);
+    else snprintf(str, length, "%ld", size);
+    return str;
+}
+
+double get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "copybatch.h"
+
+
+#define MANIFEST_DELIMITERS " \t\r\n"
+
+
+typedef struct FileCopy FileCopy;
+
+typedef struct {
+    FileCopy *file;
+    long start;
+    long end;
+    char* output;  // Filtered lines of the chunk (NULL if they couldn't be filtered)
+    long length;
+    bool is_stopped;
+    bool is_done;
+} ChunkCopy;
+
+// A mapped source file which is filtered in chunks (possibly by many
+// workers at once) and written to the target file in the order of chunks
+struct FileCopy {
+    CopyJob *job;
+    MappedFile source;
+    int target_fd;
+    ChunkCopy* chunks;
+    int no_chunks;
+    int next_pending;  // First chunk which wasn't taken by a worker
+    int next_written;  // First chunk which wasn't written to the target file
+    bool is_stopped;
+    bool is_successful;
+    double start_time;
+    FileCopy *next;    // Next file in the queue of files with pending chunks
+    pthread_mutex_t mutex;
+};
+
+typedef struct {
+    CopyBatch *batch;
+    int next_job;
+    FileCopy *pending_head;
+    FileCopy *pending_tail;
+    pthread_mutex_t mutex;
+} CopyQueue;
+
+
+static bool add_dir_jobs(CopyBatch *batch, char* source_dir, char* target_dir, struct stat *target_sb);
+static bool create_dir(char* path);
+static char* join_path(char* dir, char* name);
+static void* run_copy_worker(void* arg);
+static ChunkCopy* take_pending_chunk(CopyQueue *queue);
+static void start_file_copy(CopyQueue *queue, CopyJob *job);
+static void copy_unmapped_file(CopyJob *job, double start_time);
+static FileCopy* create_file_copy(CopyJob *job, MappedFile *source, double start_time);
+static bool split_into_chunks(FileCopy *file);
+static void copy_chunk(ChunkCopy *chunk);
+static bool write_chunk(FileCopy *file, ChunkCopy *chunk);
+static void finish_file_copy(FileCopy *file);
+static long get_file_size(char* path);
+static double get_time();
+
+
+void init_copy_batch(CopyBatch *batch) {
+    batch->jobs = NULL;
+    batch->no_jobs = 0;
+    batch->capacity = 0;
+}
+
+void free_copy_batch(CopyBatch *batch) {
+    for (int i = 0; i < batch->no_jobs; i++) {
+        free(batch->jobs[i].source_path);
+        free(batch->jobs[i].target_path);
+    }
+    free(batch->jobs);
+    init_copy_batch(batch);
+}
+
+bool add_copy_job(CopyBatch *batch, char* source_path, char* target_path) {
+    if (batch->no_jobs == batch->capacity) {
+        int capacity = batch->capacity > 0 ? 2 * batch->capacity : COPY_BATCH_INITIAL_SIZE;
+        CopyJob* jobs = (CopyJob*) realloc(batch->jobs, capacity * sizeof(CopyJob));
+        if (jobs == NULL) {
+            perror("Error: Cannot allocate memory for copy jobs.\n");
+            return false;
+        }
+        batch->jobs = jobs;
+        batch->capacity = capacity;
+    }
+
+    CopyJob *job = &batch->jobs[batch->no_jobs];
+    memset(job, 0, sizeof(CopyJob));
+    job->source_path = strdup(source_path);
+    job->target_path = strdup(target_path);
+    if (job->source_path == NULL || job->target_path == NULL) {
+        perror("Error: Cannot allocate memory for copy jobs.\n");
+        free(job->source_path);
+        free(job->target_path);
+        return false;
+    }
+    batch->no_jobs++;
+    return true;
+}
+
+bool read_copy_manifest(CopyBatch *batch, char* path) {
+    FILE* f_ptr = fopen(path, "r");
+    if (f_ptr == NULL) {
+        perror("Error: Cannot open the manifest file.\n");
+        return false;
+    }
+
+    char* line = NULL;
+    size_t size = 0;
+    int line_no = 0;
+    bool is_successful = true;
+
+    while (is_successful && getline(&line, &size, f_ptr) >= 0) {
+        line_no++;
+        char* save_ptr;
+        char* source_path = strtok_r(line, MANIFEST_DELIMITERS, &save_ptr);
+        // Skip lines without any paths
+        if (source_path == NULL) continue;
+        char* target_path = strtok_r(NULL, MANIFEST_DELIMITERS, &save_ptr);
+        if (target_path == NULL || strtok_r(NULL, MANIFEST_DELIMITERS, &save_ptr) != NULL) {
+            fprintf(stderr, "Error: Expected a source and a target path in the line %d of the manifest.\n", line_no);
+            is_successful = false;
+        } else {
+            is_successful = add_copy_job(batch, source_path, target_path);
+        }
+    }
+
+    free(line);
+    fclose(f_ptr);
+    return is_successful;
+}
+
+bool read_copy_dirs(CopyBatch *batch, char* source_dir, char* target_dir) {
+    // Create the target directory first, so that it can be recognized (by
+    // the device and inode numbers) if it is inside the source directory
+    struct stat source_sb, target_sb;
+    if (!create_dir(target_dir)) return false;
+    if (stat(source_dir, &source_sb) < 0 || stat(target_dir, &target_sb) < 0) {
+        fprintf(stderr, "Error: Cannot read the directory '%s' or '%s'.\n", source_dir, target_dir);
+        return false;
+    }
+    if (source_sb.st_dev == target_sb.st_dev && source_sb.st_ino == target_sb.st_ino) {
+        fprintf(stderr, "Error: Cannot copy the directory '%s' to itself.\n", source_dir);
+        return false;
+    }
+    return add_dir_jobs(batch, source_dir, target_dir, &target_sb);
+}
+
+bool run_copy_batch(CopyBatch *batch, int no_workers, double *time) {
+    if (no_workers < 1) no_workers = 1;
+    if (no_workers > MAX_COPY_WORKERS) no_workers = MAX_COPY_WORKERS;
+
+    CopyQueue queue = {.batch = batch};
+    pthread_mutex_init(&queue.mutex, NULL);
+    double start_time = get_time();
+
+    // Files are still copied if not all workers could be started
+    pthread_t threads[MAX_COPY_WORKERS];
+    int no_threads = 0;
+    while (no_threads < no_workers &&
+           pthread_create(&threads[no_threads], NULL, run_copy_worker, &queue) == 0) {
+        no_threads++;
+    }
+    if (no_threads == 0) run_copy_worker(&queue);
+    for (int i = 0; i < no_threads; i++) pthread_join(threads[i], NULL);
+
+    *time = get_time() - start_time;
+    pthread_mutex_destroy(&queue.mutex);
+
+    bool is_successful = true;
+    for (int i = 0; i < batch->no_jobs; i++) {
+        if (!batch->jobs[i].is_successful) is_successful = false;
+    }
+    return is_successful;
+}
+
+static bool add_dir_jobs(CopyBatch *batch, char* source_dir, char* target_dir, struct stat *target_sb) {
+    if (!create_dir(target_dir)) return false;
+    DIR* dir = opendir(source_dir);
+    if (dir == NULL) {
+        fprintf(stderr, "Error: Cannot open the directory '%s'.\n", source_dir);
+        return false;
+    }
+
+    bool is_successful = true;
+    struct dirent* entry;
+    while (is_successful && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char* source_path = join_path(source_dir, entry->d_name);
+        char* target_path = join_path(target_dir, entry->d_name);
+        struct stat sb;
+        if (source_path == NULL || target_path == NULL || lstat(source_path, &sb) < 0) {
+            fprintf(stderr, "Error: Cannot read the file '%s'.\n", entry->d_name);
+            is_successful = false;
+        // Symbolic links and special files are not copied
+        } else if (S_ISDIR(sb.st_mode)) {
+            // The target directory inside the source directory isn't copied
+            // (otherwise it would be copied into itself)
+            if (sb.st_dev != target_sb->st_dev || sb.st_ino != target_sb->st_ino) {
+                is_successful = add_dir_jobs(batch, source_path, target_path, target_sb);
+            }
+        } else if (S_ISREG(sb.st_mode)) {
+            is_successful = add_copy_job(batch, source_path, target_path);
+        }
+        free(source_path);
+        free(target_path);
+    }
+
+    closedir(dir);
+    return is_successful;
+}
+
+static bool create_dir(char* path) {
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create the directory '%s'.\n", path);
+        return false;
+    }
+    return true;
+}
+
+static char* join_path(char* dir, char* name) {
+    char* path = (char*) calloc(strlen(dir) + strlen(name) + 2, sizeof(char));
+    if (path != NULL) sprintf(path, "%s/%s", dir, name);
+    return path;
+}
+
+static void* run_copy_worker(void* arg) {
+    CopyQueue *queue = (CopyQueue*) arg;
+
+    while (true) {
+        // Chunks of already opened files are taken before the next files, so
+        // only a few files are open and their filtered chunks are written
+        // soon after being filtered
+        ChunkCopy *chunk = NULL;
+        CopyJob *job = NULL;
+        pthread_mutex_lock(&queue->mutex);
+        if (queue->pending_head != NULL) chunk = take_pending_chunk(queue);
+        else if (queue->next_job < queue->batch->no_jobs) job = &queue->batch->jobs[queue->next_job++];
+        pthread_mutex_unlock(&queue->mutex);
+
+        if (chunk != NULL) copy_chunk(chunk);
+        else if (job != NULL) start_file_copy(queue, job);
+        else return NULL;
+    }
+}
+
+static ChunkCopy* take_pending_chunk(CopyQueue *queue) {
+    FileCopy *file = queue->pending_head;
+    ChunkCopy *chunk = &file->chunks[file->next_pending++];
+    // Remove the file from the queue when all its chunks are taken
+    if (file->next_pending == file->no_chunks) {
+        queue->pending_head = file->next;
+        if (queue->pending_head == NULL) queue->pending_tail = NULL;
+    }
+    return chunk;
+}
+
+static void start_file_copy(CopyQueue *queue, CopyJob *job) {
+    double start_time = get_time();
+    int source_fd = open(job->source_path, O_RDONLY);
+    if (source_fd < 0) {
+        fprintf(stderr, "Error: Cannot open the source file '%s'.\n", job->source_path);
+        return;
+    }
+
+    // Files which cannot be mapped are copied by the library
+    MappedFile source;
+    bool is_mapped = map_file(source_fd, &source);
+    close(source_fd);
+    if (!is_mapped) {
+        copy_unmapped_file(job, start_time);
+        return;
+    }
+
+    FileCopy *file = create_file_copy(job, &source, start_time);
+    if (file == NULL) {
+        unmap_file(&source);
+        return;
+    }
+
+    // Let other workers take the remaining chunks
+    if (file->no_chunks > 1) {
+        file->next_pending = 1;
+        pthread_mutex_lock(&queue->mutex);
+        if (queue->pending_tail != NULL) queue->pending_tail->next = file;
+        else queue->pending_head = file;
+        queue->pending_tail = file;
+        pthread_mutex_unlock(&queue->mutex);
+    }
+    copy_chunk(&file->chunks[0]);
+}
+
+static void copy_unmapped_file(CopyJob *job, double start_time) {
+    // libcopysys doesn't create the target file
+    int target_fd = open(job->target_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (target_fd < 0) {
+        fprintf(stderr, "Error: Cannot create the target file '%s'.\n", job->target_path);
+        return;
+    }
+    close(target_fd);
+
+    job->is_successful = copy_file(job->source_path, job->target_path);
+    job->no_chunks = 1;
+    job->source_size = get_file_size(job->source_path);
+    job->target_size = get_file_size(job->target_path);
+    job->time = get_time() - start_time;
+}
+
+static FileCopy* create_file_copy(CopyJob *job, MappedFile *source, double start_time) {
+    FileCopy *file = (FileCopy*) calloc(1, sizeof(FileCopy));
+    if (file == NULL) {
+        perror("Error: Cannot allocate memory for a file copy.\n");
+        return NULL;
+    }
+    file->job = job;
+    file->source = *source;
+    file->start_time = start_time;
+    file->is_successful = true;
+    job->source_size = source->size;
+
+    file->target_fd = open(job->target_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file->target_fd < 0) {
+        fprintf(stderr, "Error: Cannot create the target file '%s'.\n", job->target_path);
+        free(file);
+        return NULL;
+    }
+    if (!split_into_chunks(file)) {
+        close(file->target_fd);
+        free(file);
+        return NULL;
+    }
+    pthread_mutex_init(&file->mutex, NULL);
+    return file;
+}
+
+static bool split_into_chunks(FileCopy *file) {
+    char* data = file->source.data;
+    long size = file->source.size;
+    // Every chunk except the last one has at least COPY_CHUNK_SIZE bytes
+    file->chunks = (ChunkCopy*) calloc(size / COPY_CHUNK_SIZE + 1, sizeof(ChunkCopy));
+    if (file->chunks == NULL) {
+        perror("Error: Cannot allocate memory for file chunks.\n");
+        return false;
+    }
+
+    long start = 0;
+    while (start < size) {
+        long end = start + COPY_CHUNK_SIZE;
+        // Move the end of a chunk behind the next '\n', so every line is
+        // filtered as a whole
+        if (end < size) {
+            char* newline = memchr(data + end - 1, '\n', size - end + 1);
+            end = newline != NULL ? newline - data + 1 : size;
+        } else {
+            end = size;
+        }
+        ChunkCopy *chunk = &file->chunks[file->no_chunks++];
+        chunk->file = file;
+        chunk->start = start;
+        chunk->end = end;
+        start = end;
+    }
+    return true;
+}
+
+static void copy_chunk(ChunkCopy *chunk) {
+    FileCopy *file = chunk->file;
+    // Filtered lines are never longer than the chunk
+    chunk->output = (char*) malloc(chunk->end - chunk->start);
+    if (chunk->output == NULL) {
+        perror("Error: Cannot allocate memory for a file chunk.\n");
+    } else {
+        chunk->length = filter_lines(file->source.data + chunk->start, chunk->end - chunk->start,
+                                     chunk->output, &chunk->is_stopped);
+    }
+
+    // Write all filtered chunks which follow the written ones (chunks which
+    // are filtered in the meantime wait for the mutex)
+    pthread_mutex_lock(&file->mutex);
+    chunk->is_done = true;
+    while (file->next_written < file->no_chunks && file->chunks[file->next_written].is_done) {
+        ChunkCopy *next = &file->chunks[file->next_written++];
+        if (next->output == NULL || (file->is_successful && !file->is_stopped && !write_chunk(file, next))) {
+            file->is_successful = false;
+        }
+        // Lines after the line which stopped copying are not written
+        if (next->is_stopped) file->is_stopped = true;
+        free(next->output);
+        next->output = NULL;
+    }
+    bool is_finished = file->next_written == file->no_chunks;
+    pthread_mutex_unlock(&file->mutex);
+
+    if (is_finished) finish_file_copy(file);
+}
+
+static bool write_chunk(FileCopy *file, ChunkCopy *chunk) {
+    if (chunk->length == 0) return true;
+    // Lines of chunks are separated in the same way as lines of a chunk
+    IovecBatch batch;
+    init_iovec_batch(&batch, file->target_fd);
+    long separator_length = file->job->target_size > 0 ? 1 : 0;
+    add_to_iovec_batch(&batch, "\n", separator_length);
+    add_to_iovec_batch(&batch, chunk->output, chunk->length);
+    if (!flush_iovec_batch(&batch)) return false;
+    file->job->target_size += separator_length + chunk->length;
+    return true;
+}
+
+static void finish_file_copy(FileCopy *file) {
+    CopyJob *job = file->job;
+    if (close(file->target_fd) < 0) file->is_successful = false;
+    unmap_file(&file->source);
+    job->is_successful = file->is_successful;
+    job->no_chunks = file->no_chunks;
+    job->time = get_time() - file->start_time;
+    if (!job->is_successful) fprintf(stderr, "Error: Cannot copy the file '%s'.\n", job->source_path);
+
+    pthread_mutex_destroy(&file->mutex);
+    free(file->chunks);
+    free(file);
+}
+
+static long get_file_size(char* path) {
+    struct stat sb;
+    return stat(path, &sb) == 0 ? sb.st_size : 0;
+}
+
+static double get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
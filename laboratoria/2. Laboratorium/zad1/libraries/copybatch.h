@@ -0,0 +1,60 @@
+#ifndef COPYBATCH_H
+#define COPYBATCH_H
+
+#include <stdbool.h>
+#include "copyutils.h"
+
+#define MAX_COPY_WORKERS 64
+#define COPY_CHUNK_SIZE (16 * 1024 * 1024)
+#define COPY_BATCH_INITIAL_SIZE 64
+
+typedef struct {
+    char* source_path;
+    char* target_path;
+    long source_size;
+    long target_size;
+    int no_chunks;
+    double time;  // Seconds from opening the source file to writing the last chunk
+    bool is_successful;
+} CopyJob;
+
+typedef struct {
+    CopyJob* jobs;
+    int no_jobs;
+    int capacity;
+} CopyBatch;
+
+/*
+ * Implemented by the copy library (libcopylib or libcopysys)
+ */
+bool copy_file(char* source_path, char* target_path);
+
+// Copies non-empty lines of data to output (at least length bytes long) in
+// the same format as copy_file() and returns the length of output. Sets
+// is_stopped if lines after data mustn't be copied.
+long filter_lines(char* data, long length, char* output, bool *is_stopped);
+
+/*
+ * Batch
+ */
+void init_copy_batch(CopyBatch *batch);
+
+void free_copy_batch(CopyBatch *batch);
+
+bool add_copy_job(CopyBatch *batch, char* source_path, char* target_path);
+
+// Adds a job for every line of the manifest, which contains the source and
+// the target paths separated by whitespace
+bool read_copy_manifest(CopyBatch *batch, char* path);
+
+// Adds a job for every regular file in the source directory and its
+// subdirectories, which are created in the target directory
+// (the target directory is skipped if it is inside the source directory)
+bool read_copy_dirs(CopyBatch *batch, char* source_dir, char* target_dir);
+
+// Copies files with no_workers threads. Files larger than COPY_CHUNK_SIZE
+// are split into chunks at line boundaries, which are filtered by many
+// workers and written in order.
+bool run_copy_batch(CopyBatch *batch, int no_workers, double *time);
+
+#endif //COPYBATCH_H
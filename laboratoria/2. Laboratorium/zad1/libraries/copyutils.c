@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "copyutils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define SIMD_SCAN_KERNELS
+#endif
+
+
+typedef long (*ScanLineKernel)(char* data, long length, long *first_char);
+
+static ScanLineKernel scan_line_kernel = NULL;
+
+
+static bool copy_source_slice(IovecBatch *batch, char* data, long length);
+static ScanLineKernel select_scan_line_kernel();
+static long scan_line_scalar(char* data, long length, long *first_char);
+static long scan_line_sse2(char* data, long length, long *first_char);
+static long scan_line_avx2(char* data, long length, long *first_char);
+static long find_newline(char* data, long length, long char_offset, long *first_char);
+
+
+bool map_file(int fd, MappedFile *file) {
+    // Only non-empty regular files can be mapped
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode) || sb.st_size == 0) return false;
+
+    char* data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return false;
+    // Lines are read from the beginning to the end of a file
+    madvise(data, sb.st_size, MADV_SEQUENTIAL);
+
+    file->data = data;
+    file->size = sb.st_size;
+    return true;
+}
+
+void unmap_file(MappedFile *file) {
+    munmap(file->data, file->size);
+}
+
+void init_iovec_batch(IovecBatch *batch, int fd) {
+    batch->fd = fd;
+    batch->length = 0;
+    batch->source = NULL;
+    batch->source_fd = -1;
+    batch->kernel_copy = KERNEL_COPY_NONE;
+}
+
+void set_iovec_batch_source(IovecBatch *batch, MappedFile *source, int source_fd) {
+    batch->source = source;
+    batch->source_fd = source_fd;
+    batch->kernel_copy = KERNEL_COPY_FILE_RANGE;
+}
+
+bool add_to_iovec_batch(IovecBatch *batch, char* data, long length) {
+    if (length == 0) return true;
+    // Long slices of the source file are copied by the kernel after writing
+    // the previous slices
+    if (batch->kernel_copy != KERNEL_COPY_NONE && length >= KERNEL_COPY_MIN_LENGTH &&
+        data >= batch->source->data && data + length <= batch->source->data + batch->source->size) {
+        if (!flush_iovec_batch(batch)) return false;
+        return copy_source_slice(batch, data, length);
+    }
+    // Extend the last slice if the new one directly follows it
+    if (batch->length > 0) {
+        struct iovec *last = &batch->iov[batch->length - 1];
+        if ((char*) last->iov_base + last->iov_len == data) {
+            last->iov_len += length;
+            return true;
+        }
+    }
+    if (batch->length == IOVEC_BATCH_SIZE && !flush_iovec_batch(batch)) return false;
+    batch->iov[batch->length].iov_base = data;
+    batch->iov[batch->length].iov_len = length;
+    batch->length++;
+    return true;
+}
+
+bool flush_iovec_batch(IovecBatch *batch) {
+    struct iovec *iov = batch->iov;
+    int length = batch->length;
+    batch->length = 0;
+
+    while (length > 0) {
+        ssize_t written_length = writev(batch->fd, iov, length);
+        if (written_length < 0 && errno == EINTR) continue;
+        if (written_length <= 0) {
+            printf("Error: Cannot write lines to the file.\n");
+            return false;
+        }
+        // Skip the written slices and move the beginning of the partially
+        // written one
+        while (length > 0 && (size_t) written_length >= iov->iov_len) {
+            written_length -= iov->iov_len;
+            iov++;
+            length--;
+        }
+        if (length > 0) {
+            iov->iov_base = (char*) iov->iov_base + written_length;
+            iov->iov_len -= written_length;
+        }
+    }
+    return true;
+}
+
+static bool copy_source_slice(IovecBatch *batch, char* data, long length) {
+    off_t offset = data - batch->source->data;
+    while (length > 0) {
+        ssize_t copied_length;
+        if (batch->kernel_copy == KERNEL_COPY_FILE_RANGE) {
+            copied_length = copy_file_range(batch->source_fd, &offset, batch->fd, NULL, length, 0);
+        } else {
+            copied_length = sendfile(batch->fd, batch->source_fd, &offset, length);
+        }
+        if (copied_length < 0 && errno == EINTR) continue;
+        // Try the next way of copying if the current one isn't supported for
+        // these files and write the rest of the slice if none is supported
+        if (copied_length < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            batch->kernel_copy++;
+            if (batch->kernel_copy == KERNEL_COPY_NONE) return add_to_iovec_batch(batch, data, length);
+            continue;
+        }
+        if (copied_length <= 0) {
+            printf("Error: Cannot copy lines to the file.\n");
+            return false;
+        }
+        data += copied_length;
+        length -= copied_length;
+    }
+    return true;
+}
+
+long scan_line(char* data, long length, long *first_char) {
+    // The kernel is accessed atomically, because copy workers can call
+    // scan_line() concurrently before it is chosen
+    ScanLineKernel kernel = __atomic_load_n(&scan_line_kernel, __ATOMIC_RELAXED);
+    if (kernel == NULL) kernel = select_scan_line_kernel();
+    return kernel(data, length, first_char);
+}
+
+static ScanLineKernel select_scan_line_kernel() {
+    // Choose the fastest kernel supported by the CPU (every thread chooses
+    // the same one, so it can be chosen many times concurrently)
+    ScanLineKernel kernel = scan_line_scalar;
+    #ifdef SIMD_SCAN_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) kernel = scan_line_avx2;
+        else if (__builtin_cpu_supports("sse2")) kernel = scan_line_sse2;
+    #endif
+    __atomic_store_n(&scan_line_kernel, kernel, __ATOMIC_RELAXED);
+    return kernel;
+}
+
+static long scan_line_scalar(char* data, long length, long *first_char) {
+    for (long i = 0; i < length; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            *first_char = i;
+            return i;
+        }
+        if (c != ' ' && c != '\t' && c != '\r') return find_newline(data, length, i, first_char);
+    }
+    *first_char = length;
+    return length;
+}
+
+static long find_newline(char* data, long length, long char_offset, long *first_char) {
+    // After the first non-whitespace character only '\n' has to be found,
+    // which memchr() does faster than the classifying loops
+    *first_char = char_offset;
+    char* newline = memchr(data + char_offset, '\n', length - char_offset);
+    return newline != NULL ? newline - data : length;
+}
+
+#ifdef SIMD_SCAN_KERNELS
+/*
+ * SIMD kernels classify a block of bytes into a mask of '\n' bytes and
+ * a mask of other non-whitespace bytes (bit i describes the i-th byte of
+ * a block). The first set bit of both masks tells which of them comes
+ * first in a line.
+ */
+__attribute__((target("sse2")))
+static long scan_line_sse2(char* data, long length, long *first_char) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    long i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((__m128i*) (data + i));
+        __m128i is_nl = _mm_cmpeq_epi8(v, nl);
+        __m128i is_blank = _mm_or_si128(_mm_or_si128(is_nl, _mm_cmpeq_epi8(v, space)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr)));
+        unsigned nl_mask = (unsigned) _mm_movemask_epi8(is_nl);
+        unsigned char_mask = ~(unsigned) _mm_movemask_epi8(is_blank) & 0xffff;
+        if ((nl_mask | char_mask) == 0) continue;
+        long offset = i + __builtin_ctz(nl_mask | char_mask);
+        if (data[offset] != '\n') return find_newline(data, length, offset, first_char);
+        *first_char = offset;
+        return offset;
+    }
+
+    long offset = i + scan_line_scalar(data + i, length - i, first_char);
+    *first_char += i;
+    return offset;
+}
+
+__attribute__((target("avx2")))
+static long scan_line_avx2(char* data, long length, long *first_char) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    long i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((__m256i*) (data + i));
+        __m256i is_nl = _mm256_cmpeq_epi8(v, nl);
+        __m256i is_blank = _mm256_or_si256(_mm256_or_si256(is_nl, _mm256_cmpeq_epi8(v, space)),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(v, tab), _mm256_cmpeq_epi8(v, cr)));
+        unsigned nl_mask = (unsigned) _mm256_movemask_epi8(is_nl);
+        unsigned char_mask = ~(unsigned) _mm256_movemask_epi8(is_blank);
+        if ((nl_mask | char_mask) == 0) continue;
+        long offset = i + __builtin_ctz(nl_mask | char_mask);
+        if (data[offset] != '\n') return find_newline(data, length, offset, first_char);
+        *first_char = offset;
+        return offset;
+    }
+
+    long offset = i + scan_line_scalar(data + i, length - i, first_char);
+    *first_char += i;
+    return offset;
+}
+#endif
@@ -0,0 +1,63 @@
+#ifndef COPYUTILS_H
+#define COPYUTILS_H
+
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#define IOVEC_BATCH_SIZE 1024
+#define KERNEL_COPY_MIN_LENGTH (64 * 1024)
+
+typedef enum {
+    COPY_MODE_BUFFERED,  // Read the source file through a buffer
+    COPY_MODE_MAPPED,    // Map the source file and write lines with writev()
+    COPY_MODE_KERNEL     // As COPY_MODE_MAPPED, but long lines are copied by the kernel
+} CopyMode;
+
+typedef enum {
+    KERNEL_COPY_FILE_RANGE,  // copy_file_range()
+    KERNEL_COPY_SENDFILE,    // sendfile() if copy_file_range() isn't supported
+    KERNEL_COPY_NONE         // Slices are written with writev() as other slices
+} KernelCopy;
+
+typedef struct {
+    char* data;
+    long size;
+} MappedFile;
+
+// Collects slices of memory which are written with a single writev() call
+// per IOVEC_BATCH_SIZE slices
+typedef struct {
+    int fd;
+    int length;
+    struct iovec iov[IOVEC_BATCH_SIZE];
+    // Slices of the mapped source file which are copied by the kernel
+    MappedFile *source;
+    int source_fd;
+    KernelCopy kernel_copy;
+} IovecBatch;
+
+// Returns false if the file cannot be mapped (e.g. it is a pipe or it is
+// empty), so it has to be read in another way
+bool map_file(int fd, MappedFile *file);
+
+void unmap_file(MappedFile *file);
+
+void init_iovec_batch(IovecBatch *batch, int fd);
+
+// Slices of the source file with at least KERNEL_COPY_MIN_LENGTH bytes
+// added to the batch are copied from source_fd by the kernel (in order
+// with the other slices) instead of being written from the mapped memory
+void set_iovec_batch_source(IovecBatch *batch, MappedFile *source, int source_fd);
+
+bool add_to_iovec_batch(IovecBatch *batch, char* data, long length);
+
+bool flush_iovec_batch(IovecBatch *batch);
+
+// Returns the offset of the first '\n' in data (or length if there is no
+// '\n') and stores the offset of the first character before it which is
+// not ' ', '\t' or '\r' in first_char (or the returned offset if there is
+// no such character). Lines are scanned with SSE2 or AVX2 if the CPU
+// supports them.
+long scan_line(char* data, long length, long *first_char);
+
+#endif //COPYUTILS_H
@@ -11,10 +11,23 @@ static char* read_line(FILE* f_ptr);
 static bool write_file(FILE* f_ptr, char* line);
 static bool reached_EOF(FILE* f_ptr);
 static bool copy_file_helper(FILE *source_ptr, FILE *target_ptr);
-static bool is_whitespace(char c);
 static bool is_line_empty(char* line);
+static bool copy_mapped_file(MappedFile *source, int source_fd, int target_fd);
+static long next_mapped_line(char** data, char* end, char** line);
 
 
+static CopyMode copy_mode = COPY_MODE_BUFFERED;
+static long read_buffer_size = 0;
+
+
+void set_copy_mode(CopyMode mode) {
+    copy_mode = mode;
+}
+
+void set_read_buffer_size(long size) {
+    read_buffer_size = size > 0 ? size : 0;
+}
+
 bool copy_file(char* source_path, char* target_path) {
     // Open files streams
     FILE *source_ptr = fopen(source_path, "r");
@@ -30,10 +43,27 @@ bool copy_file(char* source_path, char* target_path) {
         return false;
     }
 
-    // Copy non-empty lines to the target file
-    bool is_successful = copy_file_helper(source_ptr, target_ptr);
+    // Read the source file through a buffer of the selected size (glibc
+    // ignores the size if the buffer isn't passed to setvbuf())
+    char* read_buffer = NULL;
+    if (read_buffer_size > 0) {
+        read_buffer = (char*) malloc(read_buffer_size);
+        if (read_buffer != NULL) setvbuf(source_ptr, read_buffer, _IOFBF, read_buffer_size);
+    }
+
+    // Copy non-empty lines to the target file (files which cannot be mapped
+    // are always read through a stream)
+    bool is_successful;
+    MappedFile source;
+    if (copy_mode != COPY_MODE_BUFFERED && map_file(fileno(source_ptr), &source)) {
+        is_successful = copy_mapped_file(&source, fileno(source_ptr), fileno(target_ptr));
+        unmap_file(&source);
+    } else {
+        is_successful = copy_file_helper(source_ptr, target_ptr);
+    }
     fclose(source_ptr);
     fclose(target_ptr);
+    free(read_buffer);
 
     // CHeck if copy operation was successfull
     if (!is_successful) {
@@ -142,13 +172,71 @@ static char* find_next_line(FILE* f_ptr) {
     }
 }
 
-static bool is_whitespace(char c) {
-    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
-}
-
 static bool is_line_empty(char* line) {
-    for (int i = 0; i < (int) strlen(line); i++) {
-        if (!is_whitespace(line[i])) return false;
+    // A line can still contain '\n' if it had no other characters
+    char* end = line + strlen(line);
+    while (line < end) {
+        long first_char;
+        long offset = scan_line(line, end - line, &first_char);
+        if (first_char < offset) return false;
+        line += offset + 1;
     }
     return true;
 }
+
+long filter_lines(char* data, long length, char* output, bool *is_stopped) {
+    // Lines are copied the same way as copy_file_helper() writes them (all
+    // lines are always copied)
+    char* end = data + length;
+    char* line;
+    long line_length, output_length = 0;
+    *is_stopped = false;
+
+    while ((line_length = next_mapped_line(&data, end, &line)) >= 0) {
+        if (output_length > 0) output[output_length++] = '\n';
+        memcpy(output + output_length, line, line_length);
+        output_length += line_length;
+    }
+
+    return output_length;
+}
+
+static bool copy_mapped_file(MappedFile *source, int source_fd, int target_fd) {
+    // Lines are written straight from the mapped file (or copied by the
+    // kernel in COPY_MODE_KERNEL), the same way as copy_file_helper() writes them
+    IovecBatch batch;
+    init_iovec_batch(&batch, target_fd);
+    if (copy_mode == COPY_MODE_KERNEL) set_iovec_batch_source(&batch, source, source_fd);
+    char* data = source->data;
+    char* end = source->data + source->size;
+    char* line;
+    long line_length;
+    bool is_first_line_written = false;
+
+    while ((line_length = next_mapped_line(&data, end, &line)) >= 0) {
+        if ((is_first_line_written && !add_to_iovec_batch(&batch, "\n", 1)) ||
+            !add_to_iovec_batch(&batch, line, line_length)) {
+            return false;
+        }
+        is_first_line_written = true;
+    }
+
+    return flush_iovec_batch(&batch);
+}
+
+static long next_mapped_line(char** data, char* end, char** line) {
+    // Returns the length of the next non-empty line of the mapped data and
+    // moves data behind it or returns -1 if there are no more lines
+    while (*data < end) {
+        long first_char;
+        long offset = scan_line(*data, end - *data, &first_char);
+        bool has_newline = offset < end - *data;
+        *line = *data;
+        *data += has_newline ? offset + 1 : offset;
+        // Two last characters of a line ("\r\n") are not copied (the last
+        // line without '\n' is copied as a whole)
+        long line_length = has_newline ? offset - 1 : offset;
+        if (line_length > 0 && first_char < line_length) return line_length;
+    }
+    return -1;
+}
@@ -4,20 +4,57 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include "libcopysys.h"
 
 
-static int get_file_size(int fd);
-static int get_cursor_pos(int fd);
+#define READ_BUFFER_SIZE (64 * 1024)
+#define WRITE_BUFFER_SIZE (64 * 1024)
+
+
+// Reads a file through a window of at least read_buffer_size bytes, which
+// grows only if a single line doesn't fit in it
+typedef struct {
+    int fd;
+    char* buffer;
+    long size;
+    long start;     // Beginning of data which wasn't returned yet
+    long end;       // End of data read from the file
+    bool is_eof;
+} Reader;
+
+// Collects small writes into WRITE_BUFFER_SIZE bytes long write() calls
+typedef struct {
+    int fd;
+    char* buffer;
+    long size;
+    long length;
+} Writer;
+
+static CopyMode copy_mode = COPY_MODE_BUFFERED;
+static long read_buffer_size = READ_BUFFER_SIZE;
+
+
 static bool copy_file_helper(int source_fd, int target_fd);
-static int get_line_length(int fd);
-static char next_char(int fd);
-static char* read_line(int fd);
-static bool is_whitespace(char c);
-static bool is_line_empty(char* line);
-static bool write_file(int fd, char* text);
+static bool copy_mapped_file(MappedFile *source, int source_fd, int target_fd);
+static long next_mapped_line(char** data, char* end, char** line, bool *is_stopped);
+static bool init_reader(Reader *reader, int fd);
+static int read_line(Reader *reader, char** line, long *length, long *first_char);
+static bool fill_reader(Reader *reader);
+static bool init_writer(Writer *writer, int fd);
+static bool write_buffered(Writer *writer, char* text, long length);
+static bool flush_writer(Writer *writer);
+static bool write_all(int fd, char* text, long length);
 
 
+void set_copy_mode(CopyMode mode) {
+    copy_mode = mode;
+}
+
+void set_read_buffer_size(long size) {
+    read_buffer_size = size > 0 ? size : READ_BUFFER_SIZE;
+}
+
 bool copy_file(char* source_path, char* target_path) {
     // Open files
     int source_fd, target_fd;
@@ -34,8 +71,16 @@ bool copy_file(char* source_path, char* target_path) {
         return false;
     }
 
-    // Copy non-empty lines to the target file
-    bool is_successful = copy_file_helper(source_fd, target_fd);
+    // Copy non-empty lines to the target file (files which cannot be mapped
+    // are always read through a buffer)
+    bool is_successful;
+    MappedFile source;
+    if (copy_mode != COPY_MODE_BUFFERED && map_file(source_fd, &source)) {
+        is_successful = copy_mapped_file(&source, source_fd, target_fd);
+        unmap_file(&source);
+    } else {
+        is_successful = copy_file_helper(source_fd, target_fd);
+    }
     close(source_fd);
     close(target_fd);
 
@@ -48,130 +93,207 @@ bool copy_file(char* source_path, char* target_path) {
     return true;
 }
 
-static int get_file_size(int fd) {
-    // Get the current cursor position
-    int curr_pos = get_cursor_pos(fd);
-    // Move the cursor to the end of a file in order to determine
-    // the file size
-    int size = (int) lseek(fd, 0, SEEK_END);
-    // Move the cursor to the previous position
-    lseek(fd, curr_pos, SEEK_SET);
-    return size;
-}
-
-static int get_cursor_pos(int fd) {
-    return lseek(fd, 0, SEEK_CUR);
-}
-
 static bool copy_file_helper(int source_fd, int target_fd) {
+    Reader reader;
+    Writer writer;
+    if (!init_reader(&reader, source_fd) || !init_writer(&writer, target_fd)) {
+        perror("Error: Cannot allocate memory for file buffers.\n");
+        free(reader.buffer);
+        return false;
+    }
+
     char* line;
+    long line_length, first_char;
     bool is_first_line_written = false;
-    int line_length;
-
-    // Loop till the end of a file is reached
-    while ((line_length = get_line_length(source_fd)) > 0) {
-        line = read_line(source_fd);
+    int status;
 
-        if (line == NULL) return false;
-        if (is_line_empty(line)) {
-            free(line);
-            continue;
-        }
+    // Loop till the end of a file or a line without any characters before
+    // '\n' is reached
+    while ((status = read_line(&reader, &line, &line_length, &first_char)) > 0 && line_length > 0) {
+        // The last character of a line ('\r' in CRLF files) is not copied,
+        // so the line is empty if it has only whitespace characters before it
+        line_length--;
+        if (first_char >= line_length) continue;
         // Write '\n' if the first line had been written before and then
         // write the current line
-        if ((is_first_line_written && !write_file(target_fd, "\n")) || !write_file(target_fd, line)) {
-            free(line);
-            return false;
-        } else is_first_line_written = true;
-        free(line);
+        if ((is_first_line_written && !write_buffered(&writer, "\n", 1)) ||
+            !write_buffered(&writer, line, line_length)) {
+            status = -1;
+            break;
+        }
+        is_first_line_written = true;
     }
 
-    // When line_length < 0 there is an error
-    return line_length >= 0;
+    // When status < 0 there is an error
+    bool is_successful = status >= 0 && flush_writer(&writer);
+    free(reader.buffer);
+    free(writer.buffer);
+    return is_successful;
 }
 
-static int get_line_length(int fd) {
-    int offset = 0;
-    char c;
+long filter_lines(char* data, long length, char* output, bool *is_stopped) {
+    // Lines are copied the same way as copy_file_helper() writes them
+    char* end = data + length;
+    char* line;
+    long line_length, output_length = 0;
 
-    do {
-        c = next_char(fd);
-        offset++;
-
-        // If the next char cannot be read
-        if (c == '\0') {
-            // Check if the end of a file has been reached
-            if (get_cursor_pos(fd) >= get_file_size(fd)) {
-                lseek(fd, -(--offset), SEEK_CUR);
-                return offset;
-            }
-            // Otherwise, there is an error
-            else {
-                printf("Error: Cannot read the next character.");
-                return -1;
-            }
+    while ((line_length = next_mapped_line(&data, end, &line, is_stopped)) >= 0) {
+        if (output_length > 0) output[output_length++] = '\n';
+        memcpy(output + output_length, line, line_length);
+        output_length += line_length;
+    }
+
+    return output_length;
+}
+
+static bool copy_mapped_file(MappedFile *source, int source_fd, int target_fd) {
+    // Lines are written straight from the mapped file (or copied by the
+    // kernel in COPY_MODE_KERNEL), the same way as copy_file_helper() writes them
+    IovecBatch batch;
+    init_iovec_batch(&batch, target_fd);
+    if (copy_mode == COPY_MODE_KERNEL) set_iovec_batch_source(&batch, source, source_fd);
+    char* data = source->data;
+    char* end = source->data + source->size;
+    char* line;
+    long line_length;
+    bool is_first_line_written = false, is_stopped;
+
+    while ((line_length = next_mapped_line(&data, end, &line, &is_stopped)) >= 0) {
+        if ((is_first_line_written && !add_to_iovec_batch(&batch, "\n", 1)) ||
+            !add_to_iovec_batch(&batch, line, line_length)) {
+            return false;
         }
-    } while (c != '\n');
+        is_first_line_written = true;
+    }
 
-    // Move the cursor back to its previous position
-    lseek(fd, -offset, SEEK_CUR);
+    return flush_iovec_batch(&batch);
+}
+
+static long next_mapped_line(char** data, char* end, char** line, bool *is_stopped) {
+    // Returns the length of the next non-empty line of the mapped data and
+    // moves data behind it or returns -1 if there are no more lines to copy
+    *is_stopped = false;
+    while (*data < end) {
+        long first_char;
+        long line_length = scan_line(*data, end - *data, &first_char);
+        // Stop at a line without any characters before '\n'
+        if (line_length == 0) {
+            *is_stopped = true;
+            return -1;
+        }
+        *line = *data;
+        *data += line_length < end - *data ? line_length + 1 : line_length;
+        // The last character of a line ('\r' in CRLF files) is not copied
+        if (first_char < line_length - 1) return line_length - 1;
+    }
+    return -1;
+}
 
-    return offset - 1;
+static bool init_reader(Reader *reader, int fd) {
+    reader->fd = fd;
+    reader->size = read_buffer_size;
+    reader->start = 0;
+    reader->end = 0;
+    reader->is_eof = false;
+    reader->buffer = (char*) malloc(reader->size);
+    return reader->buffer != NULL;
 }
 
-static char next_char(int fd) {
-    char* c = (char*) calloc(1, sizeof(char));
-    // Return '\0' character if the next char cannot be read
-    if (read(fd, c, 1) < 1) {
-        free(c);
-        return '\0';
+static int read_line(Reader *reader, char** line, long *length, long *first_char) {
+    // Returns 1 and a line without '\n' (or the remaining characters at the
+    // end of a file) with the offset of its first non-whitespace character
+    // (as scan_line()), 0 if there are no more characters or -1 on error
+    long scanned = 0;
+    *first_char = -1;
+    while (true) {
+        char* data = reader->buffer + reader->start;
+        long available = reader->end - reader->start;
+        long scan_first_char;
+        long offset = scanned + scan_line(data + scanned, available - scanned, &scan_first_char);
+        // Keep the first character found in the previously scanned part
+        if (*first_char < 0 && scanned + scan_first_char < offset) *first_char = scanned + scan_first_char;
+        if (offset < available) {
+            if (*first_char < 0) *first_char = offset;
+            *line = data;
+            *length = offset;
+            reader->start += offset + 1;
+            return 1;
+        }
+        scanned = available;
+        if (reader->is_eof) {
+            if (*first_char < 0) *first_char = scanned;
+            *line = data;
+            *length = scanned;
+            reader->start = reader->end;
+            return scanned > 0 ? 1 : 0;
+        }
+        if (!fill_reader(reader)) return -1;
     }
-    char res = c[0];
-    free(c);
-    return res;
 }
 
-static char* read_line(int fd) {
-    int length = get_line_length(fd);
-    // Check if there is an error
-    if (length < 0) return NULL;
-    char* line = (char*) calloc(length + 1, sizeof(char));
-    // Check if allocation was successful
-    if (line == NULL) {
-        perror("Error: Cannot allocate memory for a file line.\n");
-        return NULL;
+static bool fill_reader(Reader *reader) {
+    // Move the beginning of the current line to the front of the window or
+    // grow the window if the whole window is taken by the line
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    } else if (reader->end == reader->size) {
+        char* buffer = (char*) realloc(reader->buffer, 2 * reader->size);
+        if (buffer == NULL) {
+            perror("Error: Cannot allocate memory for a file line.\n");
+            return false;
+        }
+        reader->buffer = buffer;
+        reader->size *= 2;
     }
-    // Read a line from the file
-    int read_length = (int) read(fd, line, length);
-    if (read_length < length) {
+
+    ssize_t read_length;
+    do {
+        read_length = read(reader->fd, reader->buffer + reader->end, reader->size - reader->end);
+    } while (read_length < 0 && errno == EINTR);
+    if (read_length < 0) {
         printf("Error: Cannot read a line from a file.\n");
-        free(line);
-        return NULL;
+        return false;
     }
-    line[length - 1] = '\0';
-    // Skip the \n character
-    lseek(fd, 1, SEEK_CUR);
-    return line;
+    if (read_length == 0) reader->is_eof = true;
+    reader->end += read_length;
+    return true;
 }
 
-static bool is_whitespace(char c) {
-    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+static bool init_writer(Writer *writer, int fd) {
+    writer->fd = fd;
+    writer->size = WRITE_BUFFER_SIZE;
+    writer->length = 0;
+    writer->buffer = (char*) malloc(writer->size);
+    return writer->buffer != NULL;
 }
 
-static bool is_line_empty(char* line) {
-    for (int i = 0; i < (int) strlen(line); i++) {
-        if (!is_whitespace(line[i])) return false;
-    }
+static bool write_buffered(Writer *writer, char* text, long length) {
+    if (writer->length + length > writer->size && !flush_writer(writer)) return false;
+    // Texts longer than the buffer are written directly
+    if (length > writer->size) return write_all(writer->fd, text, length);
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
     return true;
 }
 
-static bool write_file(int fd, char* text) {
-    int length = strlen(text);
-    int written_length = write(fd, text, length);
+static bool flush_writer(Writer *writer) {
+    bool is_successful = write_all(writer->fd, writer->buffer, writer->length);
+    writer->length = 0;
+    return is_successful;
+}
 
-    if (written_length < length) {
-        printf("Error: Cannot write a line to the file.\n");
-        return false;
+static bool write_all(int fd, char* text, long length) {
+    while (length > 0) {
+        ssize_t written_length = write(fd, text, length);
+        if (written_length < 0 && errno == EINTR) continue;
+        if (written_length <= 0) {
+            printf("Error: Cannot write a line to the file.\n");
+            return false;
+        }
+        text += written_length;
+        length -= written_length;
     }
     return true;
 }
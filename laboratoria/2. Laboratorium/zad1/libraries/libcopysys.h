@@ -1,6 +1,14 @@
 #ifndef COPYSYS_H
 #define COPYSYS_H
 
+#include "copybatch.h"
+
+void set_copy_mode(CopyMode mode);
+
+// Sets the size of the buffer through which COPY_MODE_BUFFERED reads the
+// source file (0 restores the window of 64 KiB)
+void set_read_buffer_size(long size);
+
 bool copy_file(char* source_path, char* target_path);
 
 #endif //COPYSYS_H
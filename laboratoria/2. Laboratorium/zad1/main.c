@@ -2,8 +2,13 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 
 
+#define MANIFEST_ARG "--manifest"
+#define DIRS_ARG "--dirs"
+#define BYTES_IN_MB 1e6
+
 #define LIB_COPY_LIB "./libraries/libcopylib.h"
 #define LIB_COPY_SYS "./libraries/libcopysys.h"
 
@@ -80,9 +85,17 @@
 char* get_input_line(char* mess);
 char* get_file_path(int *i, int argc, char* argv[], char* mess);
 bool write_file(FILE* f_ptr, char* text);
+int copy_batch(int argc, char* argv[]);
+void print_batch_report(CopyBatch *batch, int no_workers, double time);
+double calc_throughput(long no_bytes, double time);
 
 
 int main(int argc, char* argv[]) {
+    // Copy many files if the manifest or directories are specified
+    if (argc > 1 && (strcmp(argv[1], MANIFEST_ARG) == 0 || strcmp(argv[1], DIRS_ARG) == 0)) {
+        return copy_batch(argc, argv);
+    }
+
     if (argc > 3) {
         printf("Error: Too many arguments.\n");
         return 1;
@@ -100,6 +113,11 @@ int main(int argc, char* argv[]) {
 
     bool is_successful;
 
+    // Select how the source file is read (e.g. COPY_MODE_MAPPED)
+    #ifdef COPY_MODE
+        set_copy_mode(COPY_MODE);
+    #endif
+
     // Open time measurements file
     #ifdef MEASURE_TIME
         FILE *f_ptr = fopen(MEASURE_TIME, "a");
@@ -185,3 +203,64 @@ bool write_file(FILE* f_ptr, char* text) {
     }
     return true;
 }
+
+int copy_batch(int argc, char* argv[]) {
+    // Usage: --manifest <manifest path> [workers]
+    //        --dirs <source dir> <target dir> [workers]
+    bool is_manifest = strcmp(argv[1], MANIFEST_ARG) == 0;
+    int no_paths = is_manifest ? 1 : 2;
+    if (argc < 2 + no_paths || argc > 3 + no_paths) {
+        printf("Error: Expected %d path(s) and an optional number of workers.\n", no_paths);
+        return 1;
+    }
+    int no_workers = argc > 2 + no_paths ? atoi(argv[2 + no_paths]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (no_workers < 1 || no_workers > MAX_COPY_WORKERS) {
+        printf("Error: Expected from 1 to %d workers.\n", MAX_COPY_WORKERS);
+        return 1;
+    }
+
+    CopyBatch batch;
+    init_copy_batch(&batch);
+    bool is_read = is_manifest ? read_copy_manifest(&batch, argv[2]) : read_copy_dirs(&batch, argv[2], argv[3]);
+    if (!is_read) {
+        printf("Error: Cannot read the files to copy.\n");
+        free_copy_batch(&batch);
+        return 1;
+    }
+
+    double time;
+    bool is_successful = run_copy_batch(&batch, no_workers, &time);
+    print_batch_report(&batch, no_workers, time);
+    free_copy_batch(&batch);
+
+    if (!is_successful) {
+        printf("Error: Failed to copy some files.\n");
+        return 1;
+    }
+    printf("Success: Finished copying.\n");
+    return 0;
+}
+
+void print_batch_report(CopyBatch *batch, int no_workers, double time) {
+    printf("%-40s %-12s %-12s %-7s %-10s %-10s\n", "Source", "Size", "Copied", "Chunks", "Time [s]", "MB/s");
+
+    long no_bytes = 0, no_copied_bytes = 0;
+    for (int i = 0; i < batch->no_jobs; i++) {
+        CopyJob *job = &batch->jobs[i];
+        printf("%-40s %-12ld %-12ld %-7d %-10.4f %-10.2f%s\n", job->source_path, job->source_size,
+               job->target_size, job->no_chunks, job->time, calc_throughput(job->source_size, job->time),
+               job->is_successful ? "" : " FAILED");
+        no_bytes += job->source_size;
+        no_copied_bytes += job->target_size;
+    }
+
+    // Throughput of the whole batch is measured from starting the first
+    // copy to finishing the last one
+    printf("%-40s %-12ld %-12ld %-7s %-10.4f %-10.2f\n", "Total", no_bytes, no_copied_bytes, "", time,
+           calc_throughput(no_bytes, time));
+    printf("Copied %d files with %d workers\n", batch->no_jobs, no_workers);
+}
+
+double calc_throughput(long no_bytes, double time) {
+    return time > 0 ? (double) no_bytes / BYTES_IN_MB / time : 0;
+}
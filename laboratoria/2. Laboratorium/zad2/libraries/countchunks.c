@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "countchunks.h"
+
+
+typedef struct {
+    char c;
+    int fd;
+    long size;
+    long chunk_size;
+    ChunkCount* counts;
+    int no_chunks;
+    int next_chunk;     // First chunk which wasn't taken by a worker
+    int first_stopped;  // First chunk which contains an empty row
+    bool is_successful;
+    pthread_mutex_t mutex;
+} ChunkQueue;
+
+
+static void* run_count_worker(void* arg);
+static bool count_chunk(ChunkQueue *queue, int idx);
+static long get_chunk_size();
+
+
+bool can_count_in_chunks(int fd) {
+    struct stat sb;
+    return fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > get_chunk_size();
+}
+
+bool count_char_in_chunks(char c, int fd, int no_workers, CountingResult *cr) {
+    if (no_workers < 1) no_workers = 1;
+    if (no_workers > MAX_COUNT_WORKERS) no_workers = MAX_COUNT_WORKERS;
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        perror("Error: Cannot get the size of a file.\n");
+        return false;
+    }
+
+    ChunkQueue queue = {.c = c, .fd = fd, .size = sb.st_size, .chunk_size = get_chunk_size(), .is_successful = true};
+    queue.no_chunks = (int) ((queue.size + queue.chunk_size - 1) / queue.chunk_size);
+    queue.first_stopped = queue.no_chunks;
+    queue.counts = (ChunkCount*) calloc(queue.no_chunks, sizeof(ChunkCount));
+    if (queue.counts == NULL) {
+        perror("Error: Cannot allocate memory for chunks counts.\n");
+        return false;
+    }
+    pthread_mutex_init(&queue.mutex, NULL);
+
+    // Chunks are still counted if not all workers could be started
+    pthread_t threads[MAX_COUNT_WORKERS];
+    int no_threads = 0;
+    while (no_threads < no_workers &&
+           pthread_create(&threads[no_threads], NULL, run_count_worker, &queue) == 0) {
+        no_threads++;
+    }
+    if (no_threads == 0) run_count_worker(&queue);
+    for (int i = 0; i < no_threads; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&queue.mutex);
+
+    // Merge counts of chunks in order (chunks after the first empty row
+    // weren't counted, but they are never merged)
+    if (queue.is_successful) {
+        CountingState state;
+        init_counting_state(&state, c);
+        for (int i = 0; i < queue.no_chunks && merge_chunk_count(&state, &queue.counts[i]); i++);
+        finish_counting(&state, cr);
+    }
+
+    free(queue.counts);
+    return queue.is_successful;
+}
+
+static void* run_count_worker(void* arg) {
+    ChunkQueue *queue = (ChunkQueue*) arg;
+
+    while (true) {
+        // Chunks after a chunk with an empty row don't have to be counted
+        pthread_mutex_lock(&queue->mutex);
+        int idx = queue->next_chunk++;
+        bool is_pending = idx < queue->no_chunks && idx < queue->first_stopped && queue->is_successful;
+        pthread_mutex_unlock(&queue->mutex);
+        if (!is_pending) return NULL;
+
+        bool is_successful = count_chunk(queue, idx);
+        pthread_mutex_lock(&queue->mutex);
+        if (!is_successful) queue->is_successful = false;
+        else if (queue->counts[idx].rest.is_stopped && idx < queue->first_stopped) queue->first_stopped = idx;
+        pthread_mutex_unlock(&queue->mutex);
+    }
+}
+
+static bool count_chunk(ChunkQueue *queue, int idx) {
+    long offset = idx * queue->chunk_size;
+    long length = queue->size - offset < queue->chunk_size ? queue->size - offset : queue->chunk_size;
+
+    char* chunk = mmap(NULL, length, PROT_READ, MAP_PRIVATE, queue->fd, offset);
+    if (chunk == MAP_FAILED) {
+        perror("Error: Cannot map a chunk of a file.\n");
+        return false;
+    }
+    madvise(chunk, length, MADV_SEQUENTIAL);
+    count_char_in_chunk(queue->c, chunk, length, &queue->counts[idx]);
+    munmap(chunk, length);
+    return true;
+}
+
+static long get_chunk_size() {
+    // Offsets of mappings must be multiples of the page size
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) page_size = 4096;
+    return COUNT_CHUNK_SIZE > page_size ? COUNT_CHUNK_SIZE / page_size * page_size : page_size;
+}
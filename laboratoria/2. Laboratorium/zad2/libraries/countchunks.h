@@ -0,0 +1,20 @@
+#ifndef COUNTCHUNKS_H
+#define COUNTCHUNKS_H
+
+#include <stdbool.h>
+#include "countutils.h"
+
+#define MAX_COUNT_WORKERS 64
+#define COUNT_CHUNK_SIZE (16 * 1024 * 1024)
+
+// Returns true if a file is a regular file larger than a single chunk
+bool can_count_in_chunks(int fd);
+
+// Counts a character in a regular file with no_workers threads. The file
+// is split into page-aligned chunks of about COUNT_CHUNK_SIZE bytes, which
+// are mapped and counted separately and merged in order, so rows split
+// between chunks are counted once and counting still stops at the first
+// empty row.
+bool count_char_in_chunks(char c, int fd, int no_workers, CountingResult *cr);
+
+#endif //COUNTCHUNKS_H
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "countutils.h"
+
+
+static void finish_line(CountingState *state);
+static long count_char_in_span(char c, char* span, long length);
+static void add_line_to_histogram(HistogramState *state, unsigned char* line, long length);
+static void count_chars_in_span(HistogramState *state, unsigned char* span, long length);
+static void flush_histogram_counts(HistogramState *state);
+
+
+void init_counting_state(CountingState *state, char c) {
+    memset(state, 0, sizeof(CountingState));
+    state->c = c;
+}
+
+bool count_char_in_block(void* arg, char* block, long length) {
+    CountingState *state = (CountingState*) arg;
+    char* end = block + length;
+    while (block < end && !state->is_stopped) {
+        char* newline = memchr(block, '\n', end - block);
+        char* line_end = newline != NULL ? newline : end;
+        state->no_in_line += count_char_in_span(state->c, block, line_end - block);
+        state->line_length += line_end - block;
+        // The rest of a line is in the next block
+        if (newline == NULL) break;
+        finish_line(state);
+        block = newline + 1;
+    }
+    return !state->is_stopped;
+}
+
+void finish_counting(CountingState *state, CountingResult *cr) {
+    if (!state->is_stopped && state->line_length > 0) finish_line(state);
+    cr->no_all = state->no_all;
+    cr->no_rows = state->no_rows;
+}
+
+void count_char_in_chunk(char c, char* chunk, long length, ChunkCount *cc) {
+    // The prefix is the end of a row which started in the previous chunks
+    char* newline = memchr(chunk, '\n', length);
+    cc->has_newline = newline != NULL;
+    cc->prefix_length = newline != NULL ? newline - chunk : length;
+    cc->no_in_prefix = count_char_in_span(c, chunk, cc->prefix_length);
+
+    init_counting_state(&cc->rest, c);
+    if (newline != NULL) count_char_in_block(&cc->rest, newline + 1, length - cc->prefix_length - 1);
+}
+
+bool merge_chunk_count(CountingState *state, ChunkCount *cc) {
+    if (state->is_stopped) return false;
+    state->no_in_line += cc->no_in_prefix;
+    state->line_length += cc->prefix_length;
+    if (!cc->has_newline) return true;
+
+    // Finish the row split between chunks and continue with the rows of
+    // the chunk
+    finish_line(state);
+    if (state->is_stopped) return false;
+    state->no_all += cc->rest.no_all;
+    state->no_rows += cc->rest.no_rows;
+    state->no_in_line = cc->rest.no_in_line;
+    state->line_length = cc->rest.line_length;
+    state->is_stopped = cc->rest.is_stopped;
+    return !state->is_stopped;
+}
+
+static void finish_line(CountingState *state) {
+    // Lines after the first empty line are not counted
+    if (state->line_length == 0) {
+        state->is_stopped = true;
+        return;
+    }
+    if (state->no_in_line > 0) {
+        state->no_all += state->no_in_line;
+        state->no_rows++;
+    }
+    state->no_in_line = 0;
+    state->line_length = 0;
+}
+
+static long count_char_in_span(char c, char* span, long length) {
+    long count = 0;
+    for (long i = 0; i < length; i++) count += span[i] == c;
+    return count;
+}
+
+void init_histogram_state(HistogramState *state) {
+    memset(state, 0, sizeof(HistogramState));
+    state->row = 1;
+}
+
+bool add_block_to_histogram(void* arg, char* block, long length) {
+    HistogramState *state = (HistogramState*) arg;
+    char* end = block + length;
+    // Lines are counted the same way as in count_char_in_block()
+    while (block < end && !state->is_stopped) {
+        char* newline = memchr(block, '\n', end - block);
+        char* line_end = newline != NULL ? newline : end;
+        add_line_to_histogram(state, (unsigned char*) block, line_end - block);
+        state->line_length += line_end - block;
+        if (newline == NULL) break;
+        if (state->line_length == 0) state->is_stopped = true;
+        state->row++;
+        state->line_length = 0;
+        block = newline + 1;
+    }
+    return !state->is_stopped;
+}
+
+void finish_histogram(HistogramState *state, CharHistogram *histogram) {
+    flush_histogram_counts(state);
+    memcpy(histogram->no_all, state->no_all, sizeof(histogram->no_all));
+    memcpy(histogram->no_rows, state->no_rows, sizeof(histogram->no_rows));
+}
+
+static void add_line_to_histogram(HistogramState *state, unsigned char* line, long length) {
+    // Count characters in parts which don't overflow the counters
+    for (long i = 0; i < length;) {
+        long part_length = length - i;
+        if (part_length > HISTOGRAM_FLUSH_SIZE - state->no_unflushed) {
+            part_length = HISTOGRAM_FLUSH_SIZE - state->no_unflushed;
+        }
+        count_chars_in_span(state, line + i, part_length);
+        state->no_unflushed += part_length;
+        if (state->no_unflushed == HISTOGRAM_FLUSH_SIZE) flush_histogram_counts(state);
+        i += part_length;
+    }
+
+    // A row is counted once for every character which appears in it (the
+    // stamp of a character differs only at its first occurrence in a row)
+    for (long i = 0; i < length; i++) {
+        if (state->row_stamps[line[i]] != state->row) {
+            state->row_stamps[line[i]] = state->row;
+            state->no_rows[line[i]]++;
+        }
+    }
+}
+
+static void count_chars_in_span(HistogramState *state, unsigned char* span, long length) {
+    uint32_t (*counts)[NO_CHARS] = state->counts;
+    long i = 0;
+    for (; i + HISTOGRAM_TABLES <= length; i += HISTOGRAM_TABLES) {
+        counts[0][span[i]]++;
+        counts[1][span[i + 1]]++;
+        counts[2][span[i + 2]]++;
+        counts[3][span[i + 3]]++;
+    }
+    for (; i < length; i++) counts[0][span[i]]++;
+}
+
+static void flush_histogram_counts(HistogramState *state) {
+    for (int i = 0; i < HISTOGRAM_TABLES; i++) {
+        for (int j = 0; j < NO_CHARS; j++) state->no_all[j] += state->counts[i][j];
+    }
+    memset(state->counts, 0, sizeof(state->counts));
+    state->no_unflushed = 0;
+}
@@ -0,0 +1,83 @@
+#ifndef COUNTUTILS_H
+#define COUNTUTILS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define COUNT_BUFFER_SIZE (256 * 1024)
+#define NO_CHARS 256
+#define HISTOGRAM_TABLES 4
+#define HISTOGRAM_FLUSH_SIZE (1L << 30)
+
+typedef struct {
+    long no_all;
+    long no_rows;
+} CountingResult;
+
+// State of counting a character in consecutive blocks of a file (a line
+// can be split between blocks)
+typedef struct {
+    char c;
+    long no_all;
+    long no_rows;
+    long no_in_line;   // Occurrences in the current line
+    long line_length;  // Characters of the current line counted so far
+    bool is_stopped;   // Counting stops at the first empty line
+} CountingState;
+
+// Counts of a chunk of a file, which can start and end in the middle of
+// rows, merged with counts of the previous chunks in merge_chunk_count()
+typedef struct {
+    bool has_newline;
+    long no_in_prefix;    // Occurrences before the first newline
+    long prefix_length;
+    CountingState rest;   // Rows after the first newline
+} ChunkCount;
+
+typedef struct {
+    long no_all[NO_CHARS];
+    long no_rows[NO_CHARS];  // Rows which contain a character
+} CharHistogram;
+
+// State of building a histogram of all characters in consecutive blocks
+// of a file. Consecutive characters are counted in HISTOGRAM_TABLES
+// interleaved tables, so increments of the same counter don't wait for
+// each other, which are added to the totals every HISTOGRAM_FLUSH_SIZE
+// characters (before the 32-bit counters overflow).
+typedef struct {
+    uint32_t counts[HISTOGRAM_TABLES][NO_CHARS];
+    long no_unflushed;
+    long no_all[NO_CHARS];
+    long no_rows[NO_CHARS];
+    long row_stamps[NO_CHARS];  // Last row in which a character was counted
+    long row;
+    long line_length;
+    bool is_stopped;
+} HistogramState;
+
+// Counts a block of a file with the given state and returns false if the
+// following blocks don't have to be counted
+typedef bool (*BlockCounter)(void* state, char* block, long length);
+
+void init_counting_state(CountingState *state, char c);
+
+// BlockCounter of CountingState
+bool count_char_in_block(void* state, char* block, long length);
+
+// Counts the last line if it doesn't end with '\n'
+void finish_counting(CountingState *state, CountingResult *cr);
+
+void count_char_in_chunk(char c, char* chunk, long length, ChunkCount *cc);
+
+// Adds counts of the next chunk to the state of the previous chunks and
+// returns false if the following chunks don't have to be merged
+bool merge_chunk_count(CountingState *state, ChunkCount *cc);
+
+void init_histogram_state(HistogramState *state);
+
+// BlockCounter of HistogramState
+bool add_block_to_histogram(void* state, char* block, long length);
+
+void finish_histogram(HistogramState *state, CharHistogram *histogram);
+
+#endif //COUNTUTILS_H
@@ -3,47 +3,21 @@
 #include <stdbool.h>
 #include <string.h>
 #include "libcountlib.h"
+#include "countchunks.h"
+
 
-/*
- * Better implementation
- */
-//CountingResult* count_char_in_file(char c, char* path) {
-//    FILE *f_ptr = fopen(path, "r");
-//
-//    if (f_ptr == NULL) {
-//        perror("Error: Cannot open the file.\n");
-//        return NULL;
-//    }
-//
-//    CountingResult *cr = (CountingResult*) malloc(sizeof(CountingResult));
-//    cr->no_rows = 0;
-//    cr->no_all = 0;
-//
-//    char curr_c;
-//    int no_in_line = 0;
-//    do {
-//        curr_c = fgetc(f_ptr);
-//        if (curr_c == c) no_in_line++;
-//        else if (curr_c == '\n' || curr_c == EOF) {
-//            cr->no_all += no_in_line;
-//            if (no_in_line > 0) cr->no_rows++;
-//            no_in_line = 0;
-//        }
-//    } while (curr_c != EOF);
-//
-//    fclose(f_ptr);
-//
-//    return cr;
-//}
-
-/*
- * Worse implementation
- */
-static int get_line_length(FILE* f_ptr);
-static char* read_line(FILE* f_ptr);
 static bool handle_char_counting(char c, FILE* f_ptr, CountingResult *cr);
+static bool handle_histogram_building(FILE* f_ptr, CharHistogram *histogram);
+static bool count_blocks(FILE* f_ptr, BlockCounter count_block, void* state);
+
+
+static int count_workers = 1;
 
 
+void set_count_workers(int no_workers) {
+    count_workers = no_workers;
+}
+
 CountingResult* count_char_in_file(char c, char* path) {
     FILE *f_ptr = fopen(path, "r");
 
@@ -52,19 +26,47 @@ CountingResult* count_char_in_file(char c, char* path) {
         return NULL;
     }
 
-    // Perform char counting
+    // Perform char counting (large files are counted in chunks by many
+    // workers)
     CountingResult *cr = (CountingResult*) malloc(sizeof(CountingResult));
-    bool is_successful = handle_char_counting(c, f_ptr, cr);
+    bool is_successful = cr != NULL;
+    if (is_successful && count_workers > 1 && can_count_in_chunks(fileno(f_ptr))) {
+        is_successful = count_char_in_chunks(c, fileno(f_ptr), count_workers, cr);
+    } else if (is_successful) {
+        is_successful = handle_char_counting(c, f_ptr, cr);
+    }
+    fclose(f_ptr);
 
-    // CHeck if counting operation was successful
+    // Check if counting operation was successful
     if (!is_successful) {
-        printf("Error: Cannot copy a file.\n");
+        printf("Error: Cannot count characters in a file.\n");
+        free(cr);
+        return NULL;
+    }
+
+    return cr;
+}
+
+CharHistogram* build_char_histogram(char* path) {
+    FILE *f_ptr = fopen(path, "r");
+
+    if (f_ptr == NULL) {
+        perror("Error: Cannot open the file.\n");
         return NULL;
     }
 
+    // Count all characters in a single pass over a file
+    CharHistogram *histogram = (CharHistogram*) malloc(sizeof(CharHistogram));
+    bool is_successful = histogram != NULL && handle_histogram_building(f_ptr, histogram);
     fclose(f_ptr);
 
-    return cr;
+    if (!is_successful) {
+        printf("Error: Cannot build a histogram of characters in a file.\n");
+        free(histogram);
+        return NULL;
+    }
+
+    return histogram;
 }
 
 int count_char_in_line(char c, char* line) {
@@ -75,70 +77,45 @@ int count_char_in_line(char c, char* line) {
     return count;
 }
 
-static int get_line_length(FILE* f_ptr) {
-    int offset = 0;
-    char c;
-
-    do {
-        c = getc(f_ptr);
-        offset++;
-
-        // If reached the end of a file
-        if (c == EOF) {
-            fseek(f_ptr, -(--offset), SEEK_CUR);
-            return offset;
-        }
-    } while (c != '\n');
-
-    // Move the cursor back to its previous position
-    fseek(f_ptr, -offset, SEEK_CUR);
-
-    return offset - 1;
+static bool handle_char_counting(char c, FILE* f_ptr, CountingResult *cr) {
+    CountingState state;
+    init_counting_state(&state, c);
+    if (!count_blocks(f_ptr, count_char_in_block, &state)) return false;
+    finish_counting(&state, cr);
+    return true;
 }
 
-static char* read_line(FILE* f_ptr) {
-    int length = get_line_length(f_ptr);
-    // Check if there is an error
-    if (length < 0) return NULL;
-    char* line = (char*) calloc(length + 1, sizeof(char));
-    // Check if allocation was successful
-    if (line == NULL) {
-        perror("Error: Cannot allocate memory for a file line.\n");
-        return NULL;
-    }
-    // Read a line from the file
-    int read_length = (int) fread(line, sizeof(char), length, f_ptr);
-    if (read_length < length) {
-        printf("Error: Cannot read a line from a file.\n");
-        free(line);
-        return NULL;
+static bool handle_histogram_building(FILE* f_ptr, CharHistogram *histogram) {
+    HistogramState *state = (HistogramState*) malloc(sizeof(HistogramState));
+    if (state == NULL) {
+        perror("Error: Cannot allocate memory for a histogram.\n");
+        return false;
     }
-    // Skip the \n character
-    fseek(f_ptr, 1, SEEK_CUR);
-    return line;
+
+    init_histogram_state(state);
+    bool is_successful = count_blocks(f_ptr, add_block_to_histogram, state);
+    if (is_successful) finish_histogram(state, histogram);
+    free(state);
+    return is_successful;
 }
 
-static bool handle_char_counting(char c, FILE* f_ptr, CountingResult *cr) {
-    char* line;
-    int line_length, no_curr, no_all, no_rows;
-    no_all = no_rows = 0;
-
-    // Loop till the end of a file is reached
-    while ((line_length = get_line_length(f_ptr)) > 0) {
-        line = read_line(f_ptr);
-        if (line == NULL) return false;
-        no_curr = count_char_in_line(c, line);
-        if (no_curr > 0) {
-            no_all += no_curr;
-            no_rows++;
-        }
-        free(line);
+static bool count_blocks(FILE* f_ptr, BlockCounter count_block, void* state) {
+    char* buffer = (char*) malloc(COUNT_BUFFER_SIZE);
+    if (buffer == NULL) {
+        perror("Error: Cannot allocate memory for a file buffer.\n");
+        return false;
     }
 
-    // Save the results
-    cr->no_all = no_all;
-    cr->no_rows = no_rows;
+    // Count characters in consecutive blocks of a file (fread() reads big
+    // blocks directly to the buffer)
+    bool is_stopped = false;
+    size_t read_length;
+    while (!is_stopped && (read_length = fread(buffer, sizeof(char), COUNT_BUFFER_SIZE, f_ptr)) > 0) {
+        is_stopped = !count_block(state, buffer, (long) read_length);
+    }
 
-    // When line_length < 0 there is an error
-    return line_length >= 0;
+    bool is_successful = !ferror(f_ptr);
+    if (!is_successful) printf("Error: Cannot read a block from a file.\n");
+    free(buffer);
+    return is_successful;
 }
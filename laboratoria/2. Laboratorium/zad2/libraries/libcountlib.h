@@ -1,13 +1,19 @@
 #ifndef COUNTLIB_H
 #define COUNTLIB_H
 
-typedef struct {
-    int no_all;
-    int no_rows;
-} CountingResult;
+#include "countutils.h"
+
+// Sets the number of threads counting a character in files larger than
+// a single chunk (COUNT_CHUNK_SIZE) in count_char_in_file()
+void set_count_workers(int no_workers);
 
 CountingResult* count_char_in_file(char c, char* path);
 
+// Counts every character and rows which contain it in a single pass over
+// a file (rows are counted until the first empty row like in
+// count_char_in_file())
+CharHistogram* build_char_histogram(char* path);
+
 int count_char_in_line(char c, char* line);
 
 #endif //COUNTLIB_H
@@ -4,65 +4,22 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include "libcountlib.h"
+#include <errno.h>
+#include "libcountsys.h"
+#include "countchunks.h"
 
 
-char next_char(int fd);
+static bool handle_char_counting(char c, int fd, CountingResult *cr);
+static bool handle_histogram_building(int fd, CharHistogram *histogram);
+static bool count_blocks(int fd, BlockCounter count_block, void* state);
 
 
-char next_char(int fd) {
-    char* c = (char*) calloc(1, sizeof(char));
-    // Return '\0' character if the next char cannot be read
-    if (read(fd, c, 1) < 1) {
-        free(c);
-        return '\0';
-    }
-    char res = c[0];
-    free(c);
-    return res;
-}
+static int count_workers = 1;
 
-/*
- * Better implementation
- */
-//CountingResult* count_char_in_file(char c, char* path) {
-//    int fd = open(path, O_RDONLY);
-//
-//    if (fd < 0) {
-//        perror("Error: Cannot open the file.\n");
-//        return NULL;
-//    }
-//
-//    CountingResult *cr = (CountingResult*) malloc(sizeof(CountingResult));
-//    cr->no_rows = 0;
-//    cr->no_all = 0;
-//
-//    char curr_c;
-//    int no_in_line = 0;
-//    do {
-//        curr_c = next_char(fd);
-//        if (curr_c == c) no_in_line++;
-//        else if (curr_c == '\n' || curr_c == '\0') {
-//            cr->no_all += no_in_line;
-//            if (no_in_line > 0) cr->no_rows++;
-//            no_in_line = 0;
-//        }
-//    } while (curr_c != '\0');
-//
-//    close(fd);
-//
-//    return cr;
-//}
-
-/*
- * Worse implementation
- */
-static int get_line_length(int fd);
-static char* read_line(int fd);
-static int get_file_size(int fd);
-static int get_cursor_pos(int fd);
-static bool handle_char_counting(char c, int fd, CountingResult *cr);
 
+void set_count_workers(int no_workers) {
+    count_workers = no_workers;
+}
 
 CountingResult* count_char_in_file(char c, char* path) {
     int fd = open(path, O_RDONLY);
@@ -72,19 +29,47 @@ CountingResult* count_char_in_file(char c, char* path) {
         return NULL;
     }
 
-    // Perform char counting
+    // Perform char counting (large files are counted in chunks by many
+    // workers)
     CountingResult *cr = (CountingResult*) malloc(sizeof(CountingResult));
-    bool is_successful = handle_char_counting(c, fd, cr);
+    bool is_successful = cr != NULL;
+    if (is_successful && count_workers > 1 && can_count_in_chunks(fd)) {
+        is_successful = count_char_in_chunks(c, fd, count_workers, cr);
+    } else if (is_successful) {
+        is_successful = handle_char_counting(c, fd, cr);
+    }
+    close(fd);
 
-    // CHeck if counting operation was successful
+    // Check if counting operation was successful
     if (!is_successful) {
-        printf("Error: Cannot copy a file.\n");
+        printf("Error: Cannot count characters in a file.\n");
+        free(cr);
+        return NULL;
+    }
+
+    return cr;
+}
+
+CharHistogram* build_char_histogram(char* path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        perror("Error: Cannot open the file.\n");
         return NULL;
     }
 
+    // Count all characters in a single pass over a file
+    CharHistogram *histogram = (CharHistogram*) malloc(sizeof(CharHistogram));
+    bool is_successful = histogram != NULL && handle_histogram_building(fd, histogram);
     close(fd);
 
-    return cr;
+    if (!is_successful) {
+        printf("Error: Cannot build a histogram of characters in a file.\n");
+        free(histogram);
+        return NULL;
+    }
+
+    return histogram;
 }
 
 int count_char_in_line(char c, char* line) {
@@ -95,93 +80,48 @@ int count_char_in_line(char c, char* line) {
     return count;
 }
 
-static int get_file_size(int fd) {
-    // Get the current cursor position
-    int curr_pos = get_cursor_pos(fd);
-    // Move the cursor to the end of a file in order to determine
-    // the file size
-    int size = (int) lseek(fd, 0, SEEK_END);
-    // Move the cursor to the previous position
-    lseek(fd, curr_pos, SEEK_SET);
-    return size;
-}
-
-static int get_cursor_pos(int fd) {
-    return lseek(fd, 0, SEEK_CUR);
+static bool handle_char_counting(char c, int fd, CountingResult *cr) {
+    CountingState state;
+    init_counting_state(&state, c);
+    if (!count_blocks(fd, count_char_in_block, &state)) return false;
+    finish_counting(&state, cr);
+    return true;
 }
 
-static int get_line_length(int fd) {
-    int offset = 0;
-    char c;
-
-    do {
-        c = next_char(fd);
-        offset++;
-
-        // If the next char cannot be read
-        if (c == '\0') {
-            // Check if the end of a file has been reached
-            if (get_cursor_pos(fd) >= get_file_size(fd)) {
-                lseek(fd, -(--offset), SEEK_CUR);
-                return offset;
-            }
-            // Otherwise, there is an error
-            else {
-                printf("Error: Cannot read the next character.");
-                return -1;
-            }
-        }
-    } while (c != '\n');
-
-    // Move the cursor back to its previous position
-    lseek(fd, -offset, SEEK_CUR);
+static bool handle_histogram_building(int fd, CharHistogram *histogram) {
+    HistogramState *state = (HistogramState*) malloc(sizeof(HistogramState));
+    if (state == NULL) {
+        perror("Error: Cannot allocate memory for a histogram.\n");
+        return false;
+    }
 
-    return offset - 1;
+    init_histogram_state(state);
+    bool is_successful = count_blocks(fd, add_block_to_histogram, state);
+    if (is_successful) finish_histogram(state, histogram);
+    free(state);
+    return is_successful;
 }
 
-static char* read_line(int fd) {
-    int length = get_line_length(fd);
-    // Check if there is an error
-    if (length < 0) return NULL;
-    char* line = (char*) calloc(length + 1, sizeof(char));
-    // Check if allocation was successful
-    if (line == NULL) {
-        perror("Error: Cannot allocate memory for a file line.\n");
-        return NULL;
-    }
-    // Read a line from the file
-    int read_length = (int) read(fd, line, length);
-    if (read_length < length) {
-        printf("Error: Cannot read a line from a file.\n");
-        free(line);
-        return NULL;
+static bool count_blocks(int fd, BlockCounter count_block, void* state) {
+    char* buffer = (char*) malloc(COUNT_BUFFER_SIZE);
+    if (buffer == NULL) {
+        perror("Error: Cannot allocate memory for a file buffer.\n");
+        return false;
     }
-    // Skip the \n character
-    lseek(fd, 1, SEEK_CUR);
-    return line;
-}
 
-static bool handle_char_counting(char c, int fd, CountingResult *cr) {
-    char* line;
-    int line_length, no_curr, no_all, no_rows;
-    no_all = no_rows = 0;
-
-    // Loop till the end of a file is reached
-    while ((line_length = get_line_length(fd)) > 0) {
-        line = read_line(fd);
-        if (line == NULL) return false;
-        no_curr = count_char_in_line(c, line);
-        if (no_curr > 0) {
-            no_all += no_curr;
-            no_rows++;
+    // Count characters in consecutive blocks of a file
+    bool is_stopped = false;
+    ssize_t read_length;
+    while (!is_stopped && (read_length = read(fd, buffer, COUNT_BUFFER_SIZE)) != 0) {
+        if (read_length < 0 && errno == EINTR) continue;
+        if (read_length < 0) {
+            printf("Error: Cannot read a block from a file.\n");
+            free(buffer);
+            return false;
         }
-        free(line);
+        is_stopped = !count_block(state, buffer, read_length);
     }
 
-    // Save the results
-    cr->no_all = no_all;
-    cr->no_rows = no_rows;
-
-    // When line_length < 0 there is an error
-    return line_length >= 0;
+    free(buffer);
+    return true;
 }
@@ -16,29 +16,44 @@
 
 #ifdef MEASURE_TIME
     #include <sys/times.h>
+    #include <sys/stat.h>
     #include <unistd.h>
+    #include <time.h>
+
+    #define BYTES_IN_MB 1e6
 
     struct tms tms_start_buffer, tms_end_buffer;
     clock_t clock_t_start, clock_t_end;
+    // Clock ticks are too coarse to measure the throughput
+    struct timespec ts_start, ts_end;
 
     void start_timer() {
         clock_t_start = times(&tms_start_buffer);
+        clock_gettime(CLOCK_MONOTONIC, &ts_start);
     }
 
     void stop_timer() {
         clock_t_end = times(&tms_end_buffer);
+        clock_gettime(CLOCK_MONOTONIC, &ts_end);
     }
 
     char* get_times_header() {
-        char* s = (char*) calloc(34, sizeof(char));
+        char* s = (char*) calloc(45, sizeof(char));
         if (s == NULL) {
             perror("Error: Cannot allocate memory.\n");
             return NULL;
         }
-        sprintf(s, "%-10s %-10s %-10s\n", "Real", "System", "User");
+        sprintf(s, "%-10s %-10s %-10s %-10s\n", "Real", "System", "User", "MB/s");
         return s;
     }
 
+    double calc_throughput(char* path) {
+        struct stat sb;
+        double time = (double) (ts_end.tv_sec - ts_start.tv_sec) + (double) (ts_end.tv_nsec - ts_start.tv_nsec) / 1e9;
+        if (stat(path, &sb) < 0 || time <= 0) return 0;
+        return (double) sb.st_size / BYTES_IN_MB / time;
+    }
+
     double calc_time(clock_t end, clock_t start) {
         return (double)(end - start) / (double) sysconf(_SC_CLK_TCK);
     }
@@ -55,13 +70,14 @@
         return s;
     }
 
-    char* get_times_str() {
-        char* s = (char*) calloc(35, sizeof(char));
-        int n = 3;
+    char* get_times_str(char* path) {
+        char* s = (char*) calloc(46, sizeof(char));
+        int n = 4;
         double times[] = {
                 calc_time(clock_t_end, clock_t_start),
                 calc_time(tms_end_buffer.tms_stime, tms_start_buffer.tms_stime),
-                calc_time(tms_end_buffer.tms_cutime, tms_start_buffer.tms_cutime)
+                calc_time(tms_end_buffer.tms_cutime, tms_start_buffer.tms_cutime),
+                calc_throughput(path)
         };
         for (int i = 0; i < n; i++) {
             char* t_s = get_time_str(times[i]);
@@ -78,11 +94,11 @@
 #endif
 
 
-char get_input_char(int argc, char* argv[]);
+char* get_input_chars(int argc, char* argv[]);
 char* get_input_path(int argc, char* argv[]);
-char input_char(char* mess);
 char* input_line(char* mess);
 bool write_file(FILE* f_ptr, char* text);
+void print_histogram(char* chars, CharHistogram *histogram);
 
 
 int main(int argc, char* argv[]) {
@@ -90,9 +106,16 @@ int main(int argc, char* argv[]) {
         printf("Error: Too many arguments.\n");
         return 1;
     }
-    // Get input arguments
-    char c = get_input_char(argc, argv);
+    // Get input arguments (more than one character are counted together
+    // with a histogram of all characters)
+    char* chars = get_input_chars(argc, argv);
     char* path = get_input_path(argc, argv);
+    bool is_histogram = strlen(chars) > 1;
+
+    // Count large files with many threads (e.g. COUNT_WORKERS=4)
+    #ifdef COUNT_WORKERS
+        set_count_workers(COUNT_WORKERS);
+    #endif
 
     // Open time measurements file
     #ifdef MEASURE_TIME
@@ -122,14 +145,17 @@ int main(int argc, char* argv[]) {
         start_timer();
     #endif
 
-    // Count occurrences of the specified character and a number of
-    // rows where this character appears
-    CountingResult *cr = count_char_in_file(c, path);
+    // Count occurrences of the specified characters and a number of
+    // rows where these characters appear
+    CountingResult *cr = NULL;
+    CharHistogram *histogram = NULL;
+    if (is_histogram) histogram = build_char_histogram(path);
+    else cr = count_char_in_file(chars[0], path);
 
     // Save time measurements
     #ifdef MEASURE_TIME
         stop_timer();
-        char* times = get_times_str();
+        char* times = get_times_str(path);
         writing_success = write_file(f_ptr, times);
         free(times);
         fclose(f_ptr);
@@ -140,28 +166,29 @@ int main(int argc, char* argv[]) {
     #endif
 
     // Check if counting operation was successful
-    if (cr == NULL) {
+    if (cr == NULL && histogram == NULL) {
         printf("Error: Cannot perform character counting.\n");
         return 1;
     }
 
     // Print results to the stdout
-    printf("Number of characters: %d\n", cr->no_all);
-    printf("Number of rows:       %d\n", cr->no_rows);
+    if (is_histogram) {
+        print_histogram(chars, histogram);
+    } else {
+        printf("Number of characters: %ld\n", cr->no_all);
+        printf("Number of rows:       %ld\n", cr->no_rows);
+    }
 
     free(cr);
+    free(histogram);
 
     return 0;
 }
 
 
-char get_input_char(int argc, char* argv[]) {
-    if (argc < 2) return input_char("Please provide a single character to count.");
-    if (strlen(argv[1]) > 1) {
-        fprintf(stderr, "Error: Expected a single character, got '%s'\n", argv[1]);
-        return '\0';
-    }
-    return argv[1][0];
+char* get_input_chars(int argc, char* argv[]) {
+    if (argc < 2) return input_line("Please provide characters to count.");
+    return argv[1];
 }
 
 char* get_input_path(int argc, char* argv[]) {
@@ -169,14 +196,6 @@ char* get_input_path(int argc, char* argv[]) {
     return argv[2];
 }
 
-char input_char(char* mess) {
-    printf("%s\n>>>", mess);
-    char c;
-    scanf(" %c", &c);
-    getchar();
-    return c;
-}
-
 char* input_line(char* mess) {
     printf("%s\n>>>", mess);
     char* line;
@@ -197,3 +216,11 @@ bool write_file(FILE* f_ptr, char* text) {
     }
     return true;
 }
+
+void print_histogram(char* chars, CharHistogram *histogram) {
+    printf("%-10s %-12s %-12s\n", "Character", "Characters", "Rows");
+    for (int i = 0; chars[i] != '\0'; i++) {
+        unsigned char c = (unsigned char) chars[i];
+        printf("'%c'        %-12ld %-12ld\n", c, histogram->no_all[c], histogram->no_rows[c]);
+    }
+}
\ No newline at end of file
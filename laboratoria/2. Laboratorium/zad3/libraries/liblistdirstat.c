@@ -1,24 +1,112 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <time.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include "liblistdirstat.h"
 
+/*
+ * Private structs
+ */
+// A directory listed by a walker. Its listing is printed when it is listed
+// or, if the output is ordered, with listings of its subdirectories after
+// all directories are listed.
+typedef struct DirWork {
+    char* path;
+    char* output;
+    size_t output_length;
+    struct DirWork** subdirs;  // Stored only if the output is ordered
+    int no_subdirs;
+} DirWork;
+
+// Directories of a walker, which pushes and pops them at the bottom, while
+// other walkers steal them from the top
+typedef struct {
+    DirWork** items;
+    int top;
+    int bottom;
+    int capacity;
+    pthread_mutex_t mutex;
+} WorkDeque;
+
+typedef struct {
+    WorkDeque* deques;
+    int no_walkers;
+    int no_queued;   // Directories in the deques
+    int no_pending;  // Directories in the deques or being listed
+    bool is_failed;
+    pthread_mutex_t mutex;
+    pthread_cond_t has_work;
+} DirWalk;
+
+typedef struct {
+    DirWalk *walk;
+    int idx;
+    Stats stats;  // Merged with the global statistics after the walk
+} Walker;
+
 /*
  * Private functions
  */
 static bool list_dir_recur(char* dir_path);
 static bool list_saved_dirs(Node *head);
+static bool list_dir_entities(char* dir_path, FILE* f_ptr, Stats *stats, Node *head);
+// Listing relative to directories fds
+static bool list_dir_at_recur(int dir_fd, char* dir_abs_path, int depth);
+static bool list_dir_path_at(char* dir_abs_path, FILE* f_ptr, Stats *stats, Node *head);
+static bool list_dir_entities_at(DIR *d_ptr, char* dir_abs_path, FILE* f_ptr, Stats *stats, Node *head);
+static EntityInfo* get_entity_info_at(int dir_fd, char* dir_abs_path, struct dirent* entity);
+static char* get_type_name(unsigned char d_type);
 static int calc_trimmed_dir_path_length(char* dir_path, char* entity_name);
-static void update_stats(struct dirent* entity);
+static bool fprint_entity_info(FILE* f_ptr, EntityInfo *ei);
+static void fprint_info_headers(FILE* f_ptr);
+static void update_stats(Stats *stats, unsigned char d_type);
+static void merge_stats(Stats *target, Stats *source);
+// Parallel listing
+static bool list_dir_parallel(char* dir_path);
+static void* run_dir_walker(void* arg);
+static bool list_dir_work(Walker *walker, DirWork *work);
+static DirWork* create_dir_work(char* path);
+static void print_dir_work(DirWork *work);
+static void free_dir_work(DirWork *work, bool is_recursive);
+static bool push_work(DirWalk *walk, int idx, DirWork *work);
+static DirWork* pop_work(DirWalk *walk, int idx);
+static DirWork* steal_work(DirWalk *walk, int idx);
 
 // Global statistics
 Stats *global_stats;
 
+// Directories are listed in parallel by more than one thread
+static int list_threads = 1;
+static bool is_output_ordered = false;
+static ListMode list_mode = LIST_MODE_PATHS;
+static int list_fields = LIST_FIELDS_ALL;
+
+
+void set_list_threads(int no_threads) {
+    if (no_threads < 1) no_threads = 1;
+    if (no_threads > MAX_LIST_THREADS) no_threads = MAX_LIST_THREADS;
+    list_threads = no_threads;
+}
+
+void set_list_order(bool is_ordered) {
+    is_output_ordered = is_ordered;
+}
+
+void set_list_mode(ListMode mode) {
+    list_mode = mode;
+}
+
+void set_list_fields(int fields) {
+    list_fields = fields & LIST_FIELDS_ALL;
+}
+
 
 bool list_dir(char* dir_path) {
     // Allocate memory for the final statistics of the listed directory
@@ -28,8 +116,22 @@ bool list_dir(char* dir_path) {
         return false;
     }
     // Call a recursive function which will traverse the current
-    // directory subtree and list all entities of its subdirectories
-    bool is_successful = list_dir_recur(dir_path);
+    // directory subtree and list all entities of its subdirectories (or
+    // list subdirectories in many threads)
+    bool is_successful;
+    if (list_threads > 1) {
+        is_successful = list_dir_parallel(dir_path);
+    } else if (list_mode == LIST_MODE_AT) {
+        // The absolute path is created only once for the starting directory
+        char* dir_abs_path = get_abs_path(dir_path);
+        int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY);
+        if (dir_fd < 0) fprintf(stderr, "Error: Cannot open a directory %s\n", dir_path);
+        is_successful = dir_abs_path != NULL && dir_fd >= 0 && list_dir_at_recur(dir_fd, dir_abs_path, 0);
+        if (dir_abs_path == NULL && dir_fd >= 0) close(dir_fd);
+        free(dir_abs_path);
+    } else {
+        is_successful = list_dir_recur(dir_path);
+    }
     // Add the starting directory to the total number of directories
     global_stats->no_dirs++;
     // Check if a listing operation was successful
@@ -40,6 +142,29 @@ bool list_dir(char* dir_path) {
 }
 
 bool list_dir_recur(char* dir_path) {
+    // Create a linked list to store subdirectories that will be listed later
+    Node *head = create_ll_node("");
+    if (head == NULL) return false;
+
+    // List subdirectories of the current directory after its entities
+    bool is_successful = list_dir_entities(dir_path, stdout, global_stats, head) && list_saved_dirs(head);
+    free_ll(head);
+
+    return is_successful;
+}
+
+static bool list_saved_dirs(Node *head) {
+    Node* curr = head->next;
+
+    while (curr != NULL) {
+        // Return false if there was an error while listing a directory
+        if (!list_dir_recur(curr->text)) return false;
+        curr = curr->next;
+    }
+    return true;
+}
+
+static bool list_dir_entities(char* dir_path, FILE* f_ptr, Stats *stats, Node *head) {
     // Try to open the specified directory
     DIR *d_ptr = NULL;
     d_ptr = opendir(dir_path);
@@ -51,21 +176,18 @@ bool list_dir_recur(char* dir_path) {
     char* cwd_abs_path = get_abs_path(dir_path);
     if (cwd_abs_path == NULL) {
         perror("Cannot create an absolute path of the current directory.\n");
+        closedir(d_ptr);
         return false;
     }
 
     // Print the current directory path
-    printf("\nCURRENT DIRECTORY: \n\t%s\n\n", cwd_abs_path);
+    fprintf(f_ptr, "\nCURRENT DIRECTORY: \n\t%s\n\n", cwd_abs_path);
     // Print information table headers
-    print_info_headers();
+    fprint_info_headers(f_ptr);
     free(cwd_abs_path);
 
-    // Create a linked list to store subdirectories that will be listed later
-    Node *head = create_ll_node("");
-    if (head == NULL) return false;
-    Node *tail = head;
-
     // List details of all directory entities
+    Node *tail = head;
     struct dirent* entity;
     while (true) {
         entity = readdir(d_ptr);
@@ -76,6 +198,7 @@ bool list_dir_recur(char* dir_path) {
         EntityInfo *ei = get_entity_info(dir_path, entity);
         if (ei == NULL) {
             perror("Error: Cannot get entity info.\n");
+            closedir(d_ptr);
             return false;
         }
 
@@ -83,35 +206,356 @@ bool list_dir_recur(char* dir_path) {
         // entities later
         if (entity->d_type == DT_DIR) tail = append_to_ll(tail, ei->abs_path);
 
-        update_stats(entity);
-        print_entity_info(ei);
+        update_stats(stats, ei->d_type);
+        fprint_entity_info(f_ptr, ei);
         free_entity_info(ei);
     }
 
-    // List subdirectories of the current directory
-    bool is_successful = list_saved_dirs(head);
+    if (closedir(d_ptr) == -1) {
+        fprintf(stderr, "Error: Cannot close a directory %s\n", dir_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool list_dir_at_recur(int dir_fd, char* dir_abs_path, int depth) {
+    // Take ownership of the directory fd
+    DIR *d_ptr = fdopendir(dir_fd);
+    if (d_ptr == NULL) {
+        fprintf(stderr, "Error: Cannot open a directory %s\n", dir_abs_path);
+        close(dir_fd);
+        return false;
+    }
+
+    // List subdirectories after all entities of the current directory
+    Node *head = create_ll_node("");
+    bool is_successful = head != NULL && list_dir_entities_at(d_ptr, dir_abs_path, stdout, global_stats, head);
+
+    // The stream (and its readdir buffer) is closed before descending and
+    // only a bare fd is kept to open subdirectories relative to it. Every
+    // level keeps one fd, so below LIST_AT_MAX_DIR_FDS levels subdirectories
+    // are opened by their absolute paths instead
+    int parent_fd = -1;
+    bool has_subdirs = head != NULL && head->next != NULL;
+    if (is_successful && has_subdirs && depth < LIST_AT_MAX_DIR_FDS) parent_fd = dup(dirfd(d_ptr));
+    if (closedir(d_ptr) == -1) {
+        fprintf(stderr, "Error: Cannot close a directory %s\n", dir_abs_path);
+        is_successful = false;
+    }
+
+    for (Node *curr = has_subdirs ? head->next : NULL; is_successful && curr != NULL; curr = curr->next) {
+        char* name = strrchr(curr->text, '/') + 1;
+        int subdir_fd = parent_fd >= 0
+            ? openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW)
+            : open(curr->text, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+        if (subdir_fd < 0) {
+            fprintf(stderr, "Error: Cannot open a directory %s\n", curr->text);
+            is_successful = false;
+        } else {
+            is_successful = list_dir_at_recur(subdir_fd, curr->text, depth + 1);
+        }
+    }
+    if (parent_fd >= 0) close(parent_fd);
     free_ll(head);
-    if (!is_successful) return false;
 
+    return is_successful;
+}
+
+static bool list_dir_path_at(char* dir_abs_path, FILE* f_ptr, Stats *stats, Node *head) {
+    // Directories listed by walkers are opened by their absolute paths, but
+    // their entities are still stat'ed relative to their fds
+    DIR *d_ptr = opendir(dir_abs_path);
+    if (d_ptr == NULL) {
+        fprintf(stderr, "Error: Cannot open a directory %s\n", dir_abs_path);
+        return false;
+    }
+    bool is_successful = list_dir_entities_at(d_ptr, dir_abs_path, f_ptr, stats, head);
     if (closedir(d_ptr) == -1) {
-        fprintf(stderr, "Error: Cannot close a directory %s\n", dir_path);
+        fprintf(stderr, "Error: Cannot close a directory %s\n", dir_abs_path);
         return false;
     }
+    return is_successful;
+}
+
+static bool list_dir_entities_at(DIR *d_ptr, char* dir_abs_path, FILE* f_ptr, Stats *stats, Node *head) {
+    // Print the current directory path
+    fprintf(f_ptr, "\nCURRENT DIRECTORY: \n\t%s\n\n", dir_abs_path);
+    // Print information table headers
+    fprint_info_headers(f_ptr);
+
+    // List details of all directory entities
+    Node *tail = head;
+    struct dirent* entity;
+    while ((entity = readdir(d_ptr)) != NULL) {
+        if (strcmp(entity->d_name, ".") == 0 || strcmp(entity->d_name, "..") == 0) continue;
+
+        // Get information about the current entity
+        EntityInfo *ei = get_entity_info_at(dirfd(d_ptr), dir_abs_path, entity);
+        if (ei == NULL) {
+            perror("Error: Cannot get entity info.\n");
+            return false;
+        }
+
+        // If the current entity is a directory, store its path to list its
+        // entities later
+        if (ei->d_type == DT_DIR) tail = append_to_ll(tail, ei->abs_path);
+
+        update_stats(stats, ei->d_type);
+        fprint_entity_info(f_ptr, ei);
+        free_entity_info(ei);
+    }
 
     return true;
 }
 
-static bool list_saved_dirs(Node *head) {
-    Node* curr = head->next;
+static bool list_dir_parallel(char* dir_path) {
+    DirWalk walk = {.no_walkers = list_threads};
+    walk.deques = (WorkDeque*) calloc(walk.no_walkers, sizeof(WorkDeque));
+    // Directories are listed by their absolute paths in LIST_MODE_AT
+    char* dir_abs_path = list_mode == LIST_MODE_AT ? get_abs_path(dir_path) : NULL;
+    DirWork *root = create_dir_work(dir_abs_path != NULL ? dir_abs_path : dir_path);
+    free(dir_abs_path);
+    if (walk.deques == NULL || root == NULL) {
+        perror("Error: Cannot allocate memory\n");
+        free(walk.deques);
+        free_dir_work(root, false);
+        return false;
+    }
+    pthread_mutex_init(&walk.mutex, NULL);
+    pthread_cond_init(&walk.has_work, NULL);
+    for (int i = 0; i < walk.no_walkers; i++) pthread_mutex_init(&walk.deques[i].mutex, NULL);
+
+    // Directories are still listed if not all walkers could be started
+    Walker walkers[MAX_LIST_THREADS];
+    pthread_t threads[MAX_LIST_THREADS];
+    int no_threads = 0;
+    for (int i = 0; i < walk.no_walkers; i++) walkers[i] = (Walker) {.walk = &walk, .idx = i};
+    bool is_successful = push_work(&walk, 0, root);
+    if (!is_successful && !is_output_ordered) free_dir_work(root, false);
+    while (is_successful && no_threads < walk.no_walkers &&
+           pthread_create(&threads[no_threads], NULL, run_dir_walker, &walkers[no_threads]) == 0) {
+        no_threads++;
+    }
+    if (is_successful && no_threads == 0) run_dir_walker(&walkers[0]);
+    for (int i = 0; i < no_threads; i++) pthread_join(threads[i], NULL);
+    is_successful = is_successful && !walk.is_failed;
+
+    // Merge statistics of all walkers
+    for (int i = 0; i < walk.no_walkers; i++) merge_stats(global_stats, &walkers[i].stats);
+
+    // Directories which weren't listed after an error are freed with the
+    // tree of ordered directories or taken from the deques
+    if (is_output_ordered) {
+        if (is_successful) print_dir_work(root);
+        free_dir_work(root, true);
+    } else {
+        DirWork *work;
+        for (int i = 0; i < walk.no_walkers; i++) {
+            while ((work = pop_work(&walk, i)) != NULL) free_dir_work(work, false);
+        }
+    }
 
-    while (curr != NULL) {
-        // Return false if there was an error while listing a directory
-        if (!list_dir_recur(curr->text)) return false;
-        curr = curr->next;
+    for (int i = 0; i < walk.no_walkers; i++) {
+        pthread_mutex_destroy(&walk.deques[i].mutex);
+        free(walk.deques[i].items);
+    }
+    free(walk.deques);
+    pthread_cond_destroy(&walk.has_work);
+    pthread_mutex_destroy(&walk.mutex);
+
+    return is_successful;
+}
+
+static void* run_dir_walker(void* arg) {
+    Walker *walker = (Walker*) arg;
+    DirWalk *walk = walker->walk;
+
+    while (true) {
+        // Stop taking directories as soon as any walker fails (directories
+        // which are left in the deques are freed by the caller)
+        pthread_mutex_lock(&walk->mutex);
+        bool is_failed = walk->is_failed;
+        pthread_mutex_unlock(&walk->mutex);
+        if (is_failed) return NULL;
+
+        // Take the last pushed directory or steal the oldest directory of
+        // another walker
+        DirWork *work = pop_work(walk, walker->idx);
+        if (work == NULL) work = steal_work(walk, walker->idx);
+
+        if (work == NULL) {
+            // Wait until other walkers push directories or all directories
+            // are listed
+            pthread_mutex_lock(&walk->mutex);
+            while (walk->no_queued == 0 && walk->no_pending > 0 && !walk->is_failed) {
+                pthread_cond_wait(&walk->has_work, &walk->mutex);
+            }
+            bool is_finished = walk->no_pending == 0 || walk->is_failed;
+            pthread_mutex_unlock(&walk->mutex);
+            if (is_finished) return NULL;
+            continue;
+        }
+
+        bool is_successful = list_dir_work(walker, work);
+        pthread_mutex_lock(&walk->mutex);
+        if (!is_successful) walk->is_failed = true;
+        walk->no_pending--;
+        if (walk->no_pending == 0 || walk->is_failed) pthread_cond_broadcast(&walk->has_work);
+        pthread_mutex_unlock(&walk->mutex);
+    }
+}
+
+static bool list_dir_work(Walker *walker, DirWork *work) {
+    // Print the listing of the directory to memory, so listings of
+    // different directories are not mixed
+    FILE* f_ptr = open_memstream(&work->output, &work->output_length);
+    Node *head = create_ll_node("");
+    if (f_ptr == NULL || head == NULL) {
+        perror("Error: Cannot allocate memory\n");
+        if (f_ptr != NULL) fclose(f_ptr);
+        free_ll(head);
+        return false;
+    }
+    bool is_successful = list_mode == LIST_MODE_AT
+            ? list_dir_path_at(work->path, f_ptr, &walker->stats, head)
+            : list_dir_entities(work->path, f_ptr, &walker->stats, head);
+    fclose(f_ptr);
+
+    // Store subdirectories in order if the output is ordered
+    int no_subdirs = 0;
+    for (Node *curr = head->next; curr != NULL; curr = curr->next) no_subdirs++;
+    if (is_successful && is_output_ordered && no_subdirs > 0) {
+        work->subdirs = (DirWork**) calloc(no_subdirs, sizeof(DirWork*));
+        is_successful = work->subdirs != NULL;
+    }
+
+    // Push subdirectories to the deque of the walker
+    for (Node *curr = head->next; is_successful && curr != NULL; curr = curr->next) {
+        DirWork *subdir = create_dir_work(curr->text);
+        if (subdir == NULL) {
+            is_successful = false;
+            break;
+        }
+        if (is_output_ordered) work->subdirs[work->no_subdirs++] = subdir;
+        if (!push_work(walker->walk, walker->idx, subdir)) {
+            if (!is_output_ordered) free_dir_work(subdir, false);
+            is_successful = false;
+        }
+    }
+    free_ll(head);
+
+    if (!is_output_ordered) {
+        if (is_successful) fwrite(work->output, sizeof(char), work->output_length, stdout);
+        free_dir_work(work, false);
+    }
+    return is_successful;
+}
+
+static DirWork* create_dir_work(char* path) {
+    DirWork *work = (DirWork*) calloc(1, sizeof(DirWork));
+    if (work == NULL) return NULL;
+    work->path = (char*) calloc(strlen(path) + 1, sizeof(char));
+    if (work->path == NULL) {
+        free(work);
+        return NULL;
     }
+    strcpy(work->path, path);
+    return work;
+}
+
+static void print_dir_work(DirWork *work) {
+    // Print directories in the same order as list_dir_recur()
+    if (work->output != NULL) fwrite(work->output, sizeof(char), work->output_length, stdout);
+    for (int i = 0; i < work->no_subdirs; i++) print_dir_work(work->subdirs[i]);
+}
+
+static void free_dir_work(DirWork *work, bool is_recursive) {
+    if (work == NULL) return;
+    if (is_recursive) {
+        for (int i = 0; i < work->no_subdirs; i++) free_dir_work(work->subdirs[i], true);
+    }
+    free(work->subdirs);
+    free(work->output);
+    free(work->path);
+    free(work);
+}
+
+static bool push_work(DirWalk *walk, int idx, DirWork *work) {
+    // Count the directory before it can be taken, so the walk doesn't
+    // finish while it is in the deque
+    pthread_mutex_lock(&walk->mutex);
+    walk->no_queued++;
+    walk->no_pending++;
+    pthread_mutex_unlock(&walk->mutex);
+
+    WorkDeque *deque = &walk->deques[idx];
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom == deque->capacity) {
+        // Move directories to the beginning or grow the deque
+        if (deque->top > 0) {
+            memmove(deque->items, deque->items + deque->top, (deque->bottom - deque->top) * sizeof(DirWork*));
+            deque->bottom -= deque->top;
+            deque->top = 0;
+        } else {
+            int capacity = deque->capacity > 0 ? 2 * deque->capacity : WORK_DEQUE_INITIAL_SIZE;
+            DirWork** items = (DirWork**) realloc(deque->items, capacity * sizeof(DirWork*));
+            if (items == NULL) {
+                pthread_mutex_unlock(&deque->mutex);
+                perror("Error: Cannot allocate memory\n");
+                pthread_mutex_lock(&walk->mutex);
+                walk->no_queued--;
+                walk->no_pending--;
+                pthread_mutex_unlock(&walk->mutex);
+                return false;
+            }
+            deque->items = items;
+            deque->capacity = capacity;
+        }
+    }
+    deque->items[deque->bottom++] = work;
+    pthread_mutex_unlock(&deque->mutex);
+
+    pthread_mutex_lock(&walk->mutex);
+    pthread_cond_signal(&walk->has_work);
+    pthread_mutex_unlock(&walk->mutex);
     return true;
 }
 
+static DirWork* pop_work(DirWalk *walk, int idx) {
+    WorkDeque *deque = &walk->deques[idx];
+    DirWork *work = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom > deque->top) work = deque->items[--deque->bottom];
+    pthread_mutex_unlock(&deque->mutex);
+
+    if (work != NULL) {
+        pthread_mutex_lock(&walk->mutex);
+        walk->no_queued--;
+        pthread_mutex_unlock(&walk->mutex);
+    }
+    return work;
+}
+
+static DirWork* steal_work(DirWalk *walk, int idx) {
+    // Try deques of the following walkers in turn
+    for (int i = 1; i < walk->no_walkers; i++) {
+        WorkDeque *deque = &walk->deques[(idx + i) % walk->no_walkers];
+        DirWork *work = NULL;
+        pthread_mutex_lock(&deque->mutex);
+        if (deque->bottom > deque->top) work = deque->items[deque->top++];
+        pthread_mutex_unlock(&deque->mutex);
+
+        if (work != NULL) {
+            pthread_mutex_lock(&walk->mutex);
+            walk->no_queued--;
+            pthread_mutex_unlock(&walk->mutex);
+            return work;
+        }
+    }
+    return NULL;
+}
+
 bool is_rel_path(char* path) {
     return path != NULL && strlen(path) > 0 && path[0] == '.';
 }
@@ -193,6 +637,7 @@ EntityInfo* get_entity_info(char* dir_path, struct dirent* entity) {
     EntityInfo *ei = (EntityInfo*) malloc(sizeof(EntityInfo));
     ei->abs_path = entity_abs_path;
     ei->type = type;
+    ei->d_type = entity->d_type;
     ei->no_links = sb.st_nlink;
     ei->total_size = sb.st_size;
     ei->last_access_time = sb.st_atime;
@@ -201,9 +646,52 @@ EntityInfo* get_entity_info(char* dir_path, struct dirent* entity) {
     return ei;
 }
 
+static EntityInfo* get_entity_info_at(int dir_fd, char* dir_abs_path, struct dirent* entity) {
+    // Create the absolute path from the path of the directory
+    char* entity_abs_path = get_entity_path(dir_abs_path, entity);
+    EntityInfo *ei = (EntityInfo*) calloc(1, sizeof(EntityInfo));
+    if (entity_abs_path == NULL || ei == NULL) {
+        fprintf(stderr, "Error: Cannot create an absolute path.\n");
+        free(entity_abs_path);
+        free(ei);
+        return NULL;
+    }
+    ei->abs_path = entity_abs_path;
+    ei->d_type = entity->d_type;
+
+    // The type from the directory entry is enough if no other column is
+    // printed (some file systems don't store types in directory entries)
+    if (ei->d_type == DT_UNKNOWN || list_fields != 0) {
+        struct stat sb;
+        if (fstatat(dir_fd, entity->d_name, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
+            perror("Error: Cannot read entity stats.\n");
+            free_entity_info(ei);
+            return NULL;
+        }
+        if (ei->d_type == DT_UNKNOWN) ei->d_type = IFTODT(sb.st_mode);
+        ei->no_links = sb.st_nlink;
+        ei->total_size = sb.st_size;
+        ei->last_access_time = sb.st_atime;
+        ei->last_modification_time = sb.st_mtime;
+    }
+
+    ei->type = get_type_name(ei->d_type);
+    if (ei->type == NULL) {
+        fprintf(stderr, "Error: Cannot recognize a type of the entity.\n");
+        free_entity_info(ei);
+        return NULL;
+    }
+
+    return ei;
+}
+
 char* get_entity_type(struct dirent* entity) {
+    return get_type_name(entity->d_type);
+}
+
+static char* get_type_name(unsigned char d_type) {
     char* type = NULL;
-    switch (entity->d_type) {
+    switch (d_type) {
         case DT_REG: return "file";
         case DT_DIR: return "dir";
         case DT_CHR: return "char dev";
@@ -216,18 +704,27 @@ char* get_entity_type(struct dirent* entity) {
 }
 
 bool print_entity_info(EntityInfo *ei) {
-    printf("%8ld |", ei->no_links);
-    printf(" %9s |", ei->type);
-    printf(" %10ldB |", ei->total_size);
+    return fprint_entity_info(stdout, ei);
+}
+
+static bool fprint_entity_info(FILE* f_ptr, EntityInfo *ei) {
+    // Print only the selected columns
+    if (list_fields & LIST_FIELD_LINKS) fprintf(f_ptr, "%8ld | %9s |", ei->no_links, ei->type);
+    else fprintf(f_ptr, "%9s |", ei->type);
+    if (list_fields & LIST_FIELD_SIZE) fprintf(f_ptr, " %10ldB |", ei->total_size);
+    if (!(list_fields & LIST_FIELD_TIMES)) {
+        fprintf(f_ptr, " %s\n", ei->abs_path);
+        return true;
+    }
 
     char* lat = get_formatted_time(ei->last_access_time);
     char* lmt = get_formatted_time(ei->last_modification_time);
 
     bool status = true;
     if (lat != NULL && lmt != NULL) {
-        printf(" %s |", lat);
-        printf(" %s |", lmt);
-        printf(" %s\n", ei->abs_path);
+        fprintf(f_ptr, " %s |", lat);
+        fprintf(f_ptr, " %s |", lmt);
+        fprintf(f_ptr, " %s\n", ei->abs_path);
     } else status = false;
 
     if (lat != NULL) free(lat);
@@ -242,15 +739,22 @@ void free_entity_info(EntityInfo *ei) {
 }
 
 void print_info_headers() {
-    printf("%-8s | %-9s | %-11s | %-19s | %-19s | %s\n",
-           "No Links",
-           "Type",
-           "Size",
-           "Last access",
-           "Last modification",
-           "Absolute path");
-    for (int i = 0; i < 95; i++) printf("-");
-    printf("\n");
+    fprint_info_headers(stdout);
+}
+
+static void fprint_info_headers(FILE* f_ptr) {
+    // Print only the selected columns (and shorten the line below them)
+    int length = 95;
+    if (list_fields & LIST_FIELD_LINKS) fprintf(f_ptr, "%-8s | ", "No Links");
+    else length -= 11;
+    fprintf(f_ptr, "%-9s | ", "Type");
+    if (list_fields & LIST_FIELD_SIZE) fprintf(f_ptr, "%-11s | ", "Size");
+    else length -= 14;
+    if (list_fields & LIST_FIELD_TIMES) fprintf(f_ptr, "%-19s | %-19s | ", "Last access", "Last modification");
+    else length -= 44;
+    fprintf(f_ptr, "%s\n", "Absolute path");
+    for (int i = 0; i < length; i++) fprintf(f_ptr, "-");
+    fprintf(f_ptr, "\n");
 }
 
 void print_summary() {
@@ -268,38 +772,49 @@ void print_summary() {
     printf("\n");
 }
 
-void update_stats(struct dirent* entity) {
-    switch (entity->d_type) {
+void update_stats(Stats *stats, unsigned char d_type) {
+    switch (d_type) {
         case DT_REG:
-            global_stats->no_files++;
+            stats->no_files++;
             break;
         case DT_DIR:
-            global_stats->no_dirs++;
+            stats->no_dirs++;
             break;
         case DT_CHR:
-            global_stats->no_char_devs++;
+            stats->no_char_devs++;
             break;
         case DT_BLK:
-            global_stats->no_block_devs++;
+            stats->no_block_devs++;
             break;
         case DT_FIFO:
-            global_stats->no_fifos++;
+            stats->no_fifos++;
             break;
         case DT_LNK:
-            global_stats->no_slinks++;
+            stats->no_slinks++;
             break;
         case DT_SOCK:
-            global_stats->no_socks++;
+            stats->no_socks++;
             break;
     }
 }
 
+static void merge_stats(Stats *target, Stats *source) {
+    target->no_files += source->no_files;
+    target->no_dirs += source->no_dirs;
+    target->no_char_devs += source->no_char_devs;
+    target->no_block_devs += source->no_block_devs;
+    target->no_fifos += source->no_fifos;
+    target->no_slinks += source->no_slinks;
+    target->no_socks += source->no_socks;
+}
+
 char* get_formatted_time(time_t time) {
     // Convert time to the formatted string
     char buff[20];
-    struct tm* time_info;
-    time_info = localtime(&time);
-    strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", time_info);
+    // (localtime_r() can be called by many walkers at once)
+    struct tm time_info;
+    localtime_r(&time, &time_info);
+    strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", &time_info);
     int length = strlen(buff);
 
     // Copy formatted string to the persistent memory
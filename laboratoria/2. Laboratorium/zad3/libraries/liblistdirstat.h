@@ -5,9 +5,25 @@
 #ifndef LIBLISTDIRSTAT_H
 #define LIBLISTDIRSTAT_H
 
+#define MAX_LIST_THREADS 64
+#define WORK_DEQUE_INITIAL_SIZE 64
+// Directory fds kept open by the sequential LIST_MODE_AT (one per level)
+#define LIST_AT_MAX_DIR_FDS 64
+
+// Columns printed besides the type and the absolute path of entities
+#define LIST_FIELD_LINKS 1
+#define LIST_FIELD_SIZE 2
+#define LIST_FIELD_TIMES 4
+#define LIST_FIELDS_ALL (LIST_FIELD_LINKS | LIST_FIELD_SIZE | LIST_FIELD_TIMES)
+
 /*
  * Structs
  */
+typedef enum {
+    LIST_MODE_PATHS,  // Stat entities by absolute paths built with realpath()
+    LIST_MODE_AT      // Open and stat entities relative to their directory fd
+} ListMode;
+
 typedef struct Stats {
     int no_files;
     int no_dirs;
@@ -21,6 +37,7 @@ typedef struct Stats {
 typedef struct EntityInfo {
     char* abs_path;
     char* type;
+    unsigned char d_type;
     nlink_t no_links;
     off_t total_size;
     time_t last_access_time;
@@ -63,6 +80,25 @@ void print_summary();
  */
 char* get_formatted_time(time_t time);
 
+/*
+ * Settings
+ */
+// Lists directories with no_threads threads, each of which lists
+// directories from its own deque and steals directories from deques of
+// other threads when its deque is empty
+void set_list_threads(int no_threads);
+
+// Prints listings of directories listed by many threads in the same order
+// as listings of a single thread (after all directories are listed)
+void set_list_order(bool is_ordered);
+
+void set_list_mode(ListMode mode);
+
+// Selects columns printed besides the type and the path (LIST_FIELD_...).
+// In LIST_MODE_AT entities aren't stat'ed at all if no column is selected
+// and their type is known from their directory entry.
+void set_list_fields(int fields);
+
 /*
  * Main function
  */
@@ -22,6 +22,25 @@ int main(int argc, char* argv[]) {
     char* path = get_dir_path(argc, argv);
     if (path == NULL) return 1;
 
+    // List directories with many threads (e.g. LIST_THREADS=4), in the
+    // same order as a single thread if LIST_ORDERED is defined
+    #ifndef LIB_NFTW
+        #ifdef LIST_THREADS
+            set_list_threads(LIST_THREADS);
+        #endif
+        #ifdef LIST_ORDERED
+            set_list_order(true);
+        #endif
+        // Stat entities relative to their directories (LIST_MODE_AT) and
+        // print only some columns (e.g. LIST_FIELDS=0)
+        #ifdef LIST_MODE
+            set_list_mode(LIST_MODE);
+        #endif
+        #ifdef LIST_FIELDS
+            set_list_fields(LIST_FIELDS);
+        #endif
+    #endif
+
     if (!list_dir(path)) {
         printf("Error: Issues while listing the specified directory.\n");
         return 1;
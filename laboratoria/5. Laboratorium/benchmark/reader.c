@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fdreader.h"
+
+
+#define TEMP_FILE_TEMPLATE "/tmp/reader-benchXXXXXX"
+#define DEFAULT_INPUT_SIZE (1024 * 1024)
+#define RANDOM_SEED 2022
+#define BYTES_IN_MB 1e6
+#define NO_METHODS 4
+
+
+typedef long (*ReadMethod)(int fd, uint64_t *checksum);
+
+typedef struct {
+    char* name;
+    ReadMethod read_file;
+} Method;
+
+typedef struct {
+    long no_bytes;
+    uint64_t checksum;
+    double time;
+    long no_syscalls;
+    long no_allocations;
+} Measurement;
+
+
+// Counters of the wrapped functions (linked with -Wl,--wrap=...)
+long no_syscalls = 0;
+long no_allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+ssize_t __real_read(int fd, void* buffer, size_t count);
+off_t __real_lseek(int fd, off_t offset, int whence);
+
+
+bool generate_input(int fd, long size);
+void measure(Method *method, int fd, Measurement *m);
+long read_old_chars(int fd, uint64_t *checksum);
+long read_old_lines(int fd, uint64_t *checksum);
+long read_chars(int fd, uint64_t *checksum);
+long read_lines(int fd, uint64_t *checksum);
+char old_next_char(int fd);
+int old_get_line_length(int fd);
+char* old_read_line(int fd);
+double get_time();
+
+
+int main(int argc, char** argv) {
+    // Usage: reader [input size in bytes]
+    long size = argc > 1 ? strtol(argv[1], NULL, 10) : DEFAULT_INPUT_SIZE;
+    if (size <= 0) {
+        fprintf(stderr, "Error: Expected a positive input size, got '%s'.\n", argv[1]);
+        return 1;
+    }
+
+    char path[] = TEMP_FILE_TEMPLATE;
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Error: Cannot create a temporary file.\n");
+        return 1;
+    }
+    unlink(path);
+    if (!generate_input(fd, size)) {
+        close(fd);
+        return 1;
+    }
+
+    // The consumer used to read characters with a heap allocated byte and a
+    // read() per character and lines by reading them twice (with lseek()
+    // back to their beginning)
+    Method methods[NO_METHODS] = {
+        {"old next_char", read_old_chars},
+        {"old read_line", read_old_lines},
+        {"next_char", read_chars},
+        {"read_line", read_lines}
+    };
+
+    printf("%-15s %-10s %-10s %-10s %-12s %-12s %-10s\n",
+           "Method", "Bytes", "Time [s]", "MB/s", "Syscalls/B", "Allocs/B", "Checksum");
+    int status = 0;
+    Measurement first;
+    for (int i = 0; i < NO_METHODS; i++) {
+        Measurement m;
+        measure(&methods[i], fd, &m);
+        if (i == 0) first = m;
+        printf("%-15s %-10ld %-10.4f %-10.2f %-12.6f %-12.6f %016lx\n",
+               methods[i].name, m.no_bytes, m.time,
+               m.time > 0 ? (double) m.no_bytes / BYTES_IN_MB / m.time : 0,
+               (double) m.no_syscalls / (double) m.no_bytes,
+               (double) m.no_allocations / (double) m.no_bytes,
+               (unsigned long) m.checksum);
+        // Every method must read the same characters
+        if (m.no_bytes != first.no_bytes || m.checksum != first.checksum) {
+            fprintf(stderr, "Error: %s read different characters than %s.\n", methods[i].name, methods[0].name);
+            status = 1;
+        }
+    }
+
+    close(fd);
+    free_readers();
+    return status;
+}
+
+
+void* __wrap_malloc(size_t size) {
+    no_allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    no_allocations++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    no_allocations++;
+    return __real_realloc(ptr, size);
+}
+
+ssize_t __wrap_read(int fd, void* buffer, size_t count) {
+    no_syscalls++;
+    return __real_read(fd, buffer, count);
+}
+
+off_t __wrap_lseek(int fd, off_t offset, int whence) {
+    no_syscalls++;
+    return __real_lseek(fd, offset, whence);
+}
+
+bool generate_input(int fd, long size) {
+    // Lines of 8-80 random letters (xorshift64)
+    char* data = (char*) malloc(size);
+    if (data == NULL) {
+        perror("Error: Cannot allocate memory for the input.\n");
+        return false;
+    }
+    uint64_t state = RANDOM_SEED;
+    long line_length = 0;
+    for (long i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if (line_length == 0) line_length = 8 + (long) (state % 73);
+        data[i] = --line_length == 0 ? '\n' : (char) ('a' + state % 26);
+    }
+
+    bool is_successful = write(fd, data, size) == size;
+    if (!is_successful) fprintf(stderr, "Error: Cannot write the input file.\n");
+    free(data);
+    return is_successful;
+}
+
+void measure(Method *method, int fd, Measurement *m) {
+    lseek(fd, 0, SEEK_SET);
+    reset_reader(fd);
+    m->checksum = 0;
+
+    long start_syscalls = no_syscalls;
+    long start_allocations = no_allocations;
+    double start_time = get_time();
+    m->no_bytes = method->read_file(fd, &m->checksum);
+    m->time = get_time() - start_time;
+    m->no_syscalls = no_syscalls - start_syscalls;
+    m->no_allocations = no_allocations - start_allocations;
+}
+
+long read_old_chars(int fd, uint64_t *checksum) {
+    long no_bytes = 0;
+    char c;
+    while ((c = old_next_char(fd)) != '\0') {
+        *checksum = *checksum * 31 + (unsigned char) c;
+        no_bytes++;
+    }
+    return no_bytes;
+}
+
+long read_old_lines(int fd, uint64_t *checksum) {
+    long no_bytes = 0;
+    while (old_get_line_length(fd) > 0) {
+        char* line = old_read_line(fd);
+        if (line == NULL) break;
+        for (char* c = line; *c != '\0'; c++) *checksum = *checksum * 31 + (unsigned char) *c;
+        no_bytes += (long) strlen(line);
+        free(line);
+    }
+    return no_bytes;
+}
+
+long read_chars(int fd, uint64_t *checksum) {
+    long no_bytes = 0;
+    int c;
+    while ((c = next_char(fd)) != EOF) {
+        *checksum = *checksum * 31 + (unsigned char) c;
+        no_bytes++;
+    }
+    return no_bytes;
+}
+
+long read_lines(int fd, uint64_t *checksum) {
+    long no_bytes = 0;
+    char* line;
+    while ((line = read_line(fd)) != NULL) {
+        for (char* c = line; *c != '\0'; c++) *checksum = *checksum * 31 + (unsigned char) *c;
+        no_bytes += (long) strlen(line);
+        free(line);
+    }
+    return no_bytes;
+}
+
+char old_next_char(int fd) {
+    char* c = (char*) calloc(1, sizeof(char));
+    // Return '\0' character if the next char cannot be read
+    if (read(fd, c, 1) < 1) {
+        free(c);
+        return '\0';
+    }
+    char res = c[0];
+    free(c);
+    return res;
+}
+
+int old_get_line_length(int fd) {
+    int offset = 0;
+    char c;
+
+    do {
+        c = old_next_char(fd);
+        offset++;
+
+        // If the next char cannot be read, the end of a file has been
+        // reached (the input has no '\0' characters)
+        if (c == '\0') {
+            lseek(fd, -(--offset), SEEK_CUR);
+            return offset;
+        }
+    } while (c != '\n');
+
+    // Move the cursor back to its previous position
+    lseek(fd, -offset, SEEK_CUR);
+
+    return offset;
+}
+
+char* old_read_line(int fd) {
+    int length = old_get_line_length(fd);
+    char* line = (char*) calloc(length + 1, sizeof(char));
+    if (line == NULL) {
+        perror("Error: Cannot allocate memory for a file line.\n");
+        return NULL;
+    }
+    if (read(fd, line, length) < length) {
+        printf("Error: Cannot read a line from a file.\n");
+        free(line);
+        return NULL;
+    }
+    return line;
+}
+
+double get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/file.h>
+#include "fdreader.h"
 
 #define ROW_NUM_SEP ' '
 #define EMPTY_CHAR ' '
@@ -26,11 +27,6 @@ Node* append_to_ll(Node *tail, char* string);
 int create_empty_file(char* path);
 void free_ll(Node *head);
 int calc_max_row_num_digits(void);
-char next_char(int fd);
-int get_file_size(int fd);
-int get_line_length(int fd);
-int get_cursor_pos(int fd);
-char* read_line(int fd);
 
 
 int main(int argc, char* argv[]) {
@@ -57,6 +53,7 @@ int main(int argc, char* argv[]) {
 
     int status = consume(fifo_ptr, file_path, N);
     fclose(fifo_ptr);
+    free_readers();
 
     printf("Consumer %d finished.\n", getpid());
     return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -202,96 +199,24 @@ int append_to_file_row(int row_num, char* content, Node *head) {
     return 0;
 }
 
-char next_char(int fd) {
-    char* c = (char*) calloc(1, sizeof(char));
-    // Return '\0' character if the next char cannot be read
-    if (read(fd, c, 1) < 1) {
-        free(c);
-        return '\0';
-    }
-    char res = c[0];
-    free(c);
-    return res;
-}
-
-int get_file_size(int fd) {
-    // Get the current cursor position
-    int curr_pos = get_cursor_pos(fd);
-    // Move the cursor to the end of a file in order to determine
-    // the file size
-    int size = (int) lseek(fd, 0, SEEK_END);
-    // Move the cursor to the previous position
-    lseek(fd, curr_pos, SEEK_SET);
-    return size;
-}
-
-int get_cursor_pos(int fd) {
-    return (int) lseek(fd, 0, SEEK_CUR);
-}
-
-int get_line_length(int fd) {
-    int offset = 0;
-    char c;
-
-    do {
-        c = next_char(fd);
-        offset++;
-
-        // If the next char cannot be read
-        if (c == '\0') {
-            // Check if the end of a file has been reached
-            if (get_cursor_pos(fd) >= get_file_size(fd)) {
-                lseek(fd, -(--offset), SEEK_CUR);
-                return offset;
-            }
-                // Otherwise, there is an error
-            else {
-                printf("Error: Cannot read the next character.");
-                return -1;
-            }
-        }
-    } while (c != '\n');
-
-    // Move the cursor back to its previous position
-    lseek(fd, -offset, SEEK_CUR);
-
-    return offset;
-}
-
-char* read_line(int fd) {
-    int length = get_line_length(fd);
-    // Check if there is an error
-    if (length < 0) return NULL;
-    char* line = (char*) calloc(length + 1, sizeof(char));
-    // Check if allocation was successful
-    if (line == NULL) {
-        perror("Error: Cannot allocate memory for a file line.\n");
-        return NULL;
-    }
-    // Read a line from the file
-    int read_length = (int) read(fd, line, length);
-    if (read_length < length) {
-        printf("Error: Cannot read a line from a file.\n");
-        free(line);
-        return NULL;
-    }
-    return line;
-}
-
 Node* read_file_lines(int fd) {
     Node *head = create_ll_node(NULL);
     Node *tail = head;
 
     char* line;
     lseek(fd, 0, SEEK_SET);
+    // Lines are read through a buffer of the descriptor, which is reused
+    // every time the file is read
+    reset_reader(fd);
 
-    while (get_line_length(fd) > 0) {
-        line = read_line(fd);
-        if (!line || !(tail = append_to_ll(tail, line))) {
+    while ((line = read_line(fd))) {
+        tail = append_to_ll(tail, line);
+        free(line);
+        if (!tail) {
+            reset_reader(fd);
             free_ll(head);
             return NULL;
         }
-        free(line);
     }
 
     return head;
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "fdreader.h"
+
+typedef struct {
+    long start;  // First buffered character which wasn't read
+    long end;
+    char buffer[FD_READER_BUFFER_SIZE];
+} FdReader;
+
+static FdReader* readers[FD_READER_MAX_FDS];
+
+static FdReader* get_reader(int fd);
+static int fill_buffer(int fd, FdReader *reader);
+
+
+int next_char(int fd) {
+    FdReader *reader = get_reader(fd);
+    if (!reader || !fill_buffer(fd, reader)) return EOF;
+    return (unsigned char) reader->buffer[reader->start++];
+}
+
+int peek_char(int fd) {
+    FdReader *reader = get_reader(fd);
+    if (!reader || !fill_buffer(fd, reader)) return EOF;
+    return (unsigned char) reader->buffer[reader->start];
+}
+
+char* read_line(int fd) {
+    FdReader *reader = get_reader(fd);
+    if (!reader) return NULL;
+
+    // Copy parts of a line from consecutive buffers until the newline
+    char* line = NULL;
+    long length = 0;
+    while (fill_buffer(fd, reader)) {
+        char* part = reader->buffer + reader->start;
+        long part_length = reader->end - reader->start;
+        char* newline = memchr(part, '\n', part_length);
+        if (newline) part_length = newline - part + 1;
+
+        char* new_line = (char*) realloc(line, length + part_length + 1);
+        if (!new_line) {
+            perror("Error: Cannot allocate memory for a file line.\n");
+            free(line);
+            return NULL;
+        }
+        line = new_line;
+        memcpy(line + length, part, part_length);
+        length += part_length;
+        line[length] = '\0';
+        reader->start += part_length;
+
+        if (newline) break;
+    }
+
+    return line;
+}
+
+void reset_reader(int fd) {
+    if (fd < 0 || fd >= FD_READER_MAX_FDS || !readers[fd]) return;
+    readers[fd]->start = readers[fd]->end = 0;
+}
+
+void free_readers(void) {
+    for (int fd = 0; fd < FD_READER_MAX_FDS; fd++) {
+        free(readers[fd]);
+        readers[fd] = NULL;
+    }
+}
+
+static FdReader* get_reader(int fd) {
+    if (fd < 0 || fd >= FD_READER_MAX_FDS) {
+        fprintf(stderr, "Error: Cannot read from the file descriptor %d.\n", fd);
+        return NULL;
+    }
+    if (!readers[fd] && !(readers[fd] = (FdReader*) calloc(1, sizeof(FdReader)))) {
+        perror("Error: Cannot allocate memory for a file buffer.\n");
+        return NULL;
+    }
+    return readers[fd];
+}
+
+static int fill_buffer(int fd, FdReader *reader) {
+    // Return the number of buffered characters (0 if nothing can be read)
+    if (reader->start < reader->end) return (int) (reader->end - reader->start);
+
+    ssize_t read_length;
+    do {
+        read_length = read(fd, reader->buffer, FD_READER_BUFFER_SIZE);
+    } while (read_length < 0 && errno == EINTR);
+
+    reader->start = 0;
+    reader->end = read_length > 0 ? read_length : 0;
+    return (int) reader->end;
+}
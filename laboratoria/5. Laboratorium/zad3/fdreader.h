@@ -0,0 +1,27 @@
+#ifndef FDREADER_H
+#define FDREADER_H
+
+#define FD_READER_BUFFER_SIZE (64 * 1024)
+#define FD_READER_MAX_FDS 1024
+
+// Characters are read from a file descriptor through a buffer of this
+// descriptor, which is allocated at the first read and reused until
+// free_readers() is called. Buffered characters must be discarded with
+// reset_reader() when the descriptor is moved with lseek() or closed.
+// Readers mustn't be used by many threads at once.
+
+// Returns the next character or EOF if it cannot be read
+int next_char(int fd);
+
+// Returns the next character without reading it or EOF if it cannot be read
+int peek_char(int fd);
+
+// Returns the next line (ending with '\n' unless it is the last line of a
+// file) or NULL if there are no more characters or the line cannot be read
+char* read_line(int fd);
+
+void reset_reader(int fd);
+
+void free_readers(void);
+
+#endif //FDREADER_H